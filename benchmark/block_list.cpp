@@ -0,0 +1,171 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+// Throughput of block_list sweeps for several chunk capacities, against
+// the former layout of linked chunks each holding a std::vector, and of the
+// tiled all-pairs kernel under sequential and thread policies.
+// Usage: block_list_benchmark [elements] [pair elements]
+#include "block_list.h"
+#include "policy.h"
+#include "threadexecutor.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace yapl;
+
+namespace {
+
+// Former block_list layout: a linked chain of chunks with a vector each
+class linked_vector_list {
+public:
+  linked_vector_list() : first_{nullptr}, last_{nullptr}, num_elems_{0} {}
+  ~linked_vector_list() {
+    while (first_ != nullptr) {
+      chunk * tmp = first_;
+      first_ = first_->next_;
+      delete tmp;
+    }
+  }
+
+  void add(double x) {
+    if (num_elems_ % CHUNK_SIZE == 0) {
+      chunk * tmp = new chunk;
+      if (first_ == nullptr) first_ = tmp;
+      else last_->next_ = tmp;
+      last_ = tmp;
+    }
+    last_->vec_.push_back(x);
+    num_elems_++;
+  }
+
+  template <class F>
+  void apply(F f) {
+    for (auto pblock = first_; pblock != nullptr; pblock = pblock->next_) {
+      for (auto & x : pblock->vec_) f(x);
+    }
+  }
+
+  template <class BF, class PF>
+  void apply_cartesian_unique(BF bf, PF pf) {
+    for (auto pblock = first_; pblock != nullptr; pblock = pblock->next_) {
+      for (auto i = pblock->vec_.begin(); i != pblock->vec_.end(); ++i) {
+        for (chunk * pblock2 = first_; pblock2 != pblock->next_; pblock2 = pblock2->next_) {
+          auto end2 = (pblock2 == pblock) ? i : pblock2->vec_.end();
+          for (auto j = pblock2->vec_.begin(); j != end2; ++j) bf(*i, *j);
+        }
+        pf(*i);
+      }
+    }
+  }
+
+private:
+  static constexpr size_t CHUNK_SIZE = 16;
+  struct chunk {
+    std::vector<double> vec_;
+    chunk * next_ = nullptr;
+  };
+  chunk * first_;
+  chunk * last_;
+  size_t num_elems_;
+};
+
+template <class F>
+double time_ms(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+template <class L>
+void run(const char * name, size_t n, size_t m)
+{
+  double sum = 0;
+  double pairs = 0;
+  double add = 0, apply = 0, cartesian = 0;
+  {
+    L l;
+    add = time_ms([&] { for (size_t i=0; i<n; ++i) l.add(double(i)); });
+    apply = time_ms([&] {
+      for (int r=0; r<10; ++r) l.apply([](double & x) { x = 0.5 * x + 1.0; });
+    }) / 10;
+    l.apply([&sum](double & x) { sum += x; });
+  }
+  {
+    L l;
+    for (size_t i=0; i<m; ++i) l.add(double(i));
+    cartesian = time_ms([&] {
+      l.apply_cartesian_unique([&pairs](double & x, double & y) { pairs += x * y; },
+          [&sum](double & x) { sum -= x; });
+    });
+  }
+  std::cout << name << ": add " << add << " ms, apply " << apply
+            << " ms (" << n / apply / 1e3 << " Melem/s), cartesian " << cartesian
+            << " ms (" << 0.5 * m * (m-1) / cartesian / 1e3 << " Mpairs/s)"
+            << "  [" << sum + pairs << "]\n";
+}
+
+// All-pairs kernel that updates both elements of a pair, so that it is only
+// safe to run in parallel under a conflict-free schedule
+template <class L>
+void run_pairs(const char * name, size_t m)
+{
+  L l;
+  for (size_t i=0; i<m; ++i) l.add(double(i));
+  double cartesian = time_ms([&] {
+    l.apply_cartesian_unique([](double & x, double & y) {
+        const double d = 1e-9 * (x - y);
+        x -= d;
+        y += d;
+      },
+      [](double & x) { x *= 0.5; });
+  });
+  double sum = 0;
+  for (size_t i=0; i<m; ++i) sum += l.at(i);
+  std::cout << name << ": cartesian " << cartesian
+            << " ms (" << 0.5 * m * (m-1) / cartesian / 1e3 << " Mpairs/s)"
+            << "  [" << sum << "]\n";
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+  const size_t n = (argc > 1) ? std::atoi(argv[1]) : 10000000;
+  const size_t m = (argc > 2) ? std::atoi(argv[2]) : 5000;
+
+  using policy_type = default_policy<double>;
+  run<linked_vector_list>("linked vectors (16)", n, m);
+  run<block_list<double, policy_type, 16>>("block_list<16>     ", n, m);
+  run<block_list<double, policy_type, 64>>("block_list<64>     ", n, m);
+  run<block_list<double, policy_type, 256>>("block_list<256>    ", n, m);
+  run<block_list<double, policy_type, 4096>>("block_list<4096>   ", n, m);
+
+  using thread_policy = policy<thread_executor<double>>;
+  run_pairs<block_list<double, policy_type, 64>>("block_list<64> seq    ", m);
+  run_pairs<block_list<double, thread_policy, 64>>("block_list<64> threads", m);
+  run_pairs<block_list<double, policy_type, 256>>("block_list<256> seq   ", m);
+  run_pairs<block_list<double, thread_policy, 256>>("block_list<256> threads", m);
+  return 0;
+}
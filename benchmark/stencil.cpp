@@ -0,0 +1,96 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+// Compares the compile-time stencil path against per-cell neighbour traversal.
+// Usage: stencil_benchmark [n] [repetitions]
+#include "stencil.h"
+#include "boundary.h"
+#include "cube.h"
+#include "policy.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+using namespace yapl;
+
+namespace {
+
+using cube_type = cube<float, default_policy<float>>;
+
+// Mean of every cell and its 26 neighbours through for_all_neighbours
+void neighbour_average(cube_type & in, cube_type & out)
+{
+  for (size_t k=0; k<in.size_z(); ++k) {
+    for (size_t j=0; j<in.size_y(); ++j) {
+      for (size_t i=0; i<in.size_x(); ++i) {
+        float sum = in(i,j,k);
+        in.for_all_neighbours(i, j, k, [&sum](float & x) { sum += x; });
+        out(i,j,k) = sum / 27;
+      }
+    }
+  }
+}
+
+template <class F>
+double time_ms(F f, int repetitions)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int r=0; r<repetitions; ++r) {
+    f();
+  }
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count() / repetitions;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+  const size_t n = (argc > 1) ? std::atoi(argv[1]) : 128;
+  const int repetitions = (argc > 2) ? std::atoi(argv[2]) : 10;
+
+  cube_type in{n,n,n};
+  cube_type expected{n,n,n};
+  cube_type out{n,n,n};
+  in.all().apply_indexed([](float & x, const cube_index & i) {
+    x = (i.get<0>() * 7 + i.get<1>() * 13 + i.get<2>() * 29) % 17;
+  });
+
+  const double neighbours = time_ms([&] { neighbour_average(in, expected); }, repetitions);
+  const double stencil = time_ms([&] { apply_stencil<average_27>(in, out, zero_boundary{}); }, repetitions);
+
+  float error = 0;
+  for (size_t k=0; k<n; ++k) {
+    for (size_t j=0; j<n; ++j) {
+      for (size_t i=0; i<n; ++i) {
+        error = std::max(error, std::abs(expected(i,j,k) - out(i,j,k)));
+      }
+    }
+  }
+
+  std::cout << "cube " << n << "^3, " << repetitions << " repetitions\n";
+  std::cout << "for_all_neighbours: " << neighbours << " ms\n";
+  std::cout << "apply_stencil:      " << stencil << " ms\n";
+  std::cout << "speedup:            " << neighbours / stencil << "\n";
+  std::cout << "max difference:     " << error << "\n";
+  return 0;
+}
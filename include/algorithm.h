@@ -36,6 +36,54 @@ void apply_indexed(M m, F f)
   m.apply_indexed(f);
 }
 
+template <class M, class F, class C>
+void apply(M m, F f, C c)
+{
+  m.apply(f,c);
+}
+
+template <class M, class F, class C>
+void apply_indexed(M m, F f, C c)
+{
+  m.apply_indexed(f,c);
+}
+
+template <class M, class V, class R>
+V reduce(M m, V init, R r)
+{
+  return m.reduce(init,r);
+}
+
+template <class M, class V, class R, class RM>
+V reduce(M m, V init, R r, RM mode)
+{
+  return m.reduce(init,r,mode);
+}
+
+template <class M, class V, class R, class F>
+V transform_reduce(M m, V init, R r, F f)
+{
+  return m.transform_reduce(init,r,f);
+}
+
+template <class M, class V, class R, class F, class RM>
+V transform_reduce(M m, V init, R r, F f, RM mode)
+{
+  return m.transform_reduce(init,r,f,mode);
+}
+
+template <class M, class V, class R, class F>
+V transform_reduce_indexed(M m, V init, R r, F f)
+{
+  return m.transform_reduce_indexed(init,r,f);
+}
+
+template <class M, class V, class R, class F, class RM>
+V transform_reduce_indexed(M m, V init, R r, F f, RM mode)
+{
+  return m.transform_reduce_indexed(init,r,f,mode);
+}
+
 template <class M, class BF, class LM, class MF>
 void apply_cartesian_unique(M m, BF bf, LM lm, MF mf)
 {
@@ -0,0 +1,185 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_ALLOCATION_H
+#define YAPL_ALLOCATION_H
+
+#include <new>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstddef>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Allocation strategies for block storage.
+// A strategy allocates memory for n objects of type T and releases it.
+// When initialized() is false the memory is raw and the block constructs
+// the elements. Otherwise the memory already holds the objects.
+
+namespace yapl {
+
+// Plain operator new (alignment of the platform's fundamental types)
+struct new_allocation {
+  static constexpr bool initialized() { return false; }
+
+  template <class T>
+  T * allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T))); }
+
+  template <class T>
+  void deallocate(T * p, size_t) { ::operator delete(p); }
+};
+
+// Memory aligned to A bytes (A is a power of two)
+template <size_t A>
+struct aligned_allocation {
+  static_assert((A & (A-1)) == 0, "Alignment must be a power of two");
+  static_assert(A >= sizeof(void*), "Alignment must be at least the size of a pointer");
+
+  static constexpr bool initialized() { return false; }
+
+  template <class T>
+  T * allocate(size_t n) {
+    void * p = nullptr;
+    if (posix_memalign(&p, A, n * sizeof(T)) != 0) throw std::bad_alloc{};
+    return static_cast<T*>(p);
+  }
+
+  template <class T>
+  void deallocate(T * p, size_t) { std::free(p); }
+};
+
+// Aligned to cache lines, so that aligned SIMD loads can be used
+using cache_aligned_allocation = aligned_allocation<64>;
+
+// Memory aligned to 2MB pages and advised to be backed by transparent huge
+// pages, which reduces TLB misses on large cubes. When huge pages are not
+// available the memory is used with normal pages.
+struct huge_page_allocation {
+  static constexpr bool initialized() { return false; }
+  static constexpr size_t page_size() { return 2 * 1024 * 1024; }
+
+  template <class T>
+  T * allocate(size_t n) {
+    const size_t bytes = rounded_size(n * sizeof(T));
+    void * p = nullptr;
+    if (posix_memalign(&p, page_size(), bytes) != 0) throw std::bad_alloc{};
+#ifdef MADV_HUGEPAGE
+    madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    return static_cast<T*>(p);
+  }
+
+  template <class T>
+  void deallocate(T * p, size_t) { std::free(p); }
+
+private:
+  static size_t rounded_size(size_t bytes) {
+    return (bytes + page_size() - 1) / page_size() * page_size();
+  }
+};
+
+// Storage mapped from a file. An existing file is used as is (no parsing and
+// pages are read lazily), so a cube can be reopened from a previous run.
+// A new or shorter file is extended with zeros. Changes reach the file when
+// the storage is released or when flush() is called.
+class mapped_file_allocation {
+public:
+  static constexpr bool initialized() { return true; }
+
+  explicit mapped_file_allocation(const std::string & path) : path_{path}, addr_{nullptr}, bytes_{0} {}
+
+  const std::string & path() const { return path_; }
+
+  template <class T>
+  T * allocate(size_t n);
+
+  template <class T>
+  void deallocate(T * p, size_t n);
+
+  // Synchronously writes modified pages to the file
+  void flush() const;
+
+private:
+  std::string path_;
+  void * addr_;
+  size_t bytes_;
+};
+
+template <class T>
+T * mapped_file_allocation::allocate(size_t n)
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+      "mapped_file_allocation requires a trivially copyable type");
+  bytes_ = n * sizeof(T);
+  int fd = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    throw std::system_error{errno, std::generic_category(), "cannot open " + path_};
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      (static_cast<size_t>(st.st_size) < bytes_ && ::ftruncate(fd, bytes_) != 0)) {
+    int err = errno;
+    ::close(fd);
+    throw std::system_error{err, std::generic_category(), "cannot resize " + path_};
+  }
+  // A zero length mapping is not allowed, but the block still needs a pointer
+  void * p = ::mmap(nullptr, std::max<size_t>(bytes_, 1), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  int err = errno;
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    throw std::system_error{err, std::generic_category(), "cannot map " + path_};
+  }
+  addr_ = p;
+  return static_cast<T*>(p);
+}
+
+template <class T>
+void mapped_file_allocation::deallocate(T * p, size_t)
+{
+  ::munmap(p, std::max<size_t>(bytes_, 1));
+  addr_ = nullptr;
+  bytes_ = 0;
+}
+
+inline void mapped_file_allocation::flush() const
+{
+  if (addr_ != nullptr && bytes_ != 0) {
+    ::msync(addr_, bytes_, MS_SYNC);
+  }
+}
+
+// True when copies of an allocation hand out the same storage, so that a
+// single allocation object cannot back several arrays.
+template <class A>
+struct is_shared_allocation : std::false_type {};
+
+template <>
+struct is_shared_allocation<mapped_file_allocation> : std::true_type {};
+
+}
+
+#endif
@@ -20,18 +20,43 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
  */
 #ifndef YAPL_BLOCK_H
-#define YALP_BLOCK_H
+#define YAPL_BLOCK_H
 
 #include "cube_index.h"
+#include "layout.h"
+#include "reduction.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <type_traits>
 #include <memory>
+#include <vector>
 #include <iostream>
 
 namespace yapl {
 
+// Construction modes for block storage.
+// first_touch_init: Elements are value-initialized by the policy's executor,
+// with the same partitioning used by later apply calls. Memory pages are then
+// first touched by the threads that will use them (NUMA placement).
+// no_init: Elements are left uninitialized (trivial types only).
+struct first_touch_init_t {};
+struct no_init_t {};
+
+constexpr first_touch_init_t first_touch_init{};
+constexpr no_init_t no_init{};
+
 template <class T, class P>
 class block {
 public:
-  block(size_t n);
+  using allocation_type = typename P::allocation_type;
+  using layout_type = typename P::layout_type;
+  using reference = T &;
+  using const_reference = const T &;
+
+  block(size_t n, const allocation_type & a = allocation_type{});
+  block(size_t n, first_touch_init_t, const allocation_type & a = allocation_type{});
+  block(size_t n, no_init_t, const allocation_type & a = allocation_type{});
 
   block(const block &) = delete;
   block & operator=(const block &) = delete;
@@ -39,6 +64,13 @@ public:
   block(block &&);
   block & operator=(block &&);
 
+  ~block();
+
+  const allocation_type & get_allocation() const { return alloc_; }
+
+  T * data() { return mem_; }
+  const T * data() const { return mem_; }
+
   T & operator[](size_t i) { return mem_[i]; }
   const T & operator[](size_t i) const { return mem_[i]; }
 
@@ -66,136 +98,674 @@ public:
   template <class F>
   void apply_ordered(F f, const cube_index & i) const;
 
+  template <class F, class C>
+  void apply_ordered(F f, C c, size_t n);
+
+  template <class F, class C>
+  void apply_ordered(F f, C c, size_t n) const;
+
+  template <class F, class C>
+  void apply_ordered(F f, C c, const cube_index & i);
+
+  template <class F, class C>
+  void apply_ordered(F f, C c, const cube_index & i) const;
+
   template <class F, int I>
   void apply_plane(F f, size_t p, const cube_index & i);
 
+  template <int I, class F>
+  void apply_plane_indexed(F f, size_t p, const cube_index & i) const;
+
+  // Copies plane p to or from a contiguous buffer, in cube_plane order
+  template <int I>
+  void gather_plane(T * out, size_t p, const cube_index & i) const;
+
+  template <int I>
+  void scatter_plane(const T * in, size_t p, const cube_index & i);
+
+  // Sweeps over the cells of region g, calling f(x, cube_index)
+  template <class F>
+  void apply_region(F f, const cube_region & g, const cube_index & i) const;
+
+  // Reductions: r(init, f(x1), ..., f(xn)) computed by the executor
+  template <class V, class R, class F, class M>
+  V transform_reduce(V init, R r, F f, size_t n, M mode) const;
+
+  template <class V, class R, class F, class M>
+  V transform_reduce(V init, R r, F f, const cube_index & i, M mode) const;
+
+  template <int I, class V, class R, class F, class M>
+  V transform_reduce_plane(V init, R r, F f, size_t p, const cube_index & i, M mode) const;
+
+  template <int I, class V, class R, class F, class M>
+  V transform_reduce_plane_indexed(V init, R r, F f, size_t p, const cube_index & i, M mode) const;
+
+  template <class V, class R, class F, class M>
+  V transform_reduce_region(V init, R r, F f, const cube_region & g, const cube_index & i, M mode) const;
+
 private:
-  std::unique_ptr<T[]> mem_;
+  using partitioner_type = typename P::partitioner_type;
+
+  void release();
+
+  // Value-initializes the elements. If a constructor throws, the elements
+  // already built are destroyed and the storage is released.
+  void construct_elements();
+
+  // Indexed sweeps dispatched on the storage layout
+  template <class F>
+  void apply_indexed(F f, const cube_index & i, row_major_layout) const;
+
+  template <class F, class L>
+  void apply_indexed(F f, const cube_index & i, L) const;
+
+  template <class F>
+  void apply_ordered_indexed(F f, const cube_index & i, row_major_layout) const;
+
+  template <class F, class L>
+  void apply_ordered_indexed(F f, const cube_index & i, L) const;
+
+  template <class F, class C>
+  void apply_ordered_indexed(F f, C c, const cube_index & i, row_major_layout) const;
+
+  template <class F, class C, class L>
+  void apply_ordered_indexed(F f, C c, const cube_index & i, L) const;
+
+  // Calls f(x) for the cells [first,last) of a plane
+  template <int I, class F>
+  static void plane_range(F f, T * v, size_t p, const cube_index & i, size_t first, size_t last, row_major_layout);
+
+  template <int I, class F, class L>
+  static void plane_range(F f, T * v, size_t p, const cube_index & i, size_t first, size_t last, L);
+
+private:
+  allocation_type alloc_;
+  size_t size_;
+  // Kept across calls, so that stateful partitioners can replay their mapping.
+  // Built before the storage, so that a failure leaves nothing to release.
+  std::unique_ptr<partitioner_type> part_;
+  T * mem_;
 };
 
 template <class T, class P>
-block<T,P>::block(size_t n)
+block<T,P>::block(size_t n, const allocation_type & a)
 :
-mem_{new T[n]{}}
+alloc_{a},
+size_{n},
+part_{new partitioner_type{}},
+mem_{alloc_.template allocate<T>(n)}
 {
+  if (allocation_type::initialized()) return;
+  construct_elements();
+}
+
+template <class T, class P>
+block<T,P>::block(size_t n, first_touch_init_t, const allocation_type & a)
+:
+alloc_{a},
+size_{n},
+part_{new partitioner_type{}},
+mem_{alloc_.template allocate<T>(n)}
+{
+  if (allocation_type::initialized()) return;
+  if (std::is_nothrow_default_constructible<T>::value) {
+    P::executor_type::apply([](T & x) { new (&x) T{}; }, mem_, size_, P::grain_size, *part_);
+  }
+  else {
+    // Constructors must not throw inside executor tasks, so pages are first
+    // touched in parallel and elements are then built in sequence
+    P::executor_type::apply([](T & x) { std::memset(static_cast<void*>(&x), 0, sizeof(T)); },
+        mem_, size_, P::grain_size, *part_);
+    construct_elements();
+  }
+}
+
+template <class T, class P>
+block<T,P>::block(size_t n, no_init_t, const allocation_type & a)
+:
+alloc_{a},
+size_{n},
+part_{new partitioner_type{}},
+mem_{alloc_.template allocate<T>(n)}
+{
+  static_assert(std::is_trivially_default_constructible<T>::value,
+      "no_init requires a trivially default constructible type");
 }
 
 template <class T, class P>
 block<T,P>::block(block && b)
 :
-mem_{std::move(b.mem_)}
+alloc_{std::move(b.alloc_)},
+size_{b.size_},
+part_{std::move(b.part_)},
+mem_{b.mem_}
 {
+  b.size_ = 0;
+  b.mem_ = nullptr;
 }
 
 template <class T, class P>
 block<T,P> & block<T,P>::operator=(block && b)
 {
-  mem_ = std::move(b.mem_);
+  if (this != &b) {
+    release();
+    alloc_ = std::move(b.alloc_);
+    size_ = b.size_;
+    mem_ = b.mem_;
+    part_ = std::move(b.part_);
+    b.size_ = 0;
+    b.mem_ = nullptr;
+  }
   return *this;
 }
 
+template <class T, class P>
+block<T,P>::~block()
+{
+  release();
+}
+
+template <class T, class P>
+void block<T,P>::release()
+{
+  if (mem_ == nullptr) return;
+  if (!allocation_type::initialized()) {
+    for (size_t i=0; i!=size_; ++i) {
+      mem_[i].~T();
+    }
+  }
+  alloc_.template deallocate<T>(mem_, size_);
+  mem_ = nullptr;
+  size_ = 0;
+}
+
+template <class T, class P>
+void block<T,P>::construct_elements()
+{
+  size_t i = 0;
+  try {
+    for (; i!=size_; ++i) {
+      new (mem_ + i) T{};
+    }
+  }
+  catch (...) {
+    while (i != 0) {
+      mem_[--i].~T();
+    }
+    alloc_.template deallocate<T>(mem_, size_);
+    mem_ = nullptr;
+    throw;
+  }
+}
+
 template <class T, class P>
 template <class F>
 void block<T,P>::apply(F f, size_t n)
 {
-  P::executor_type::apply(f, mem_.get(), n);
+  P::executor_type::apply(f, mem_, n, P::grain_size, *part_);
 }
 
 template <class T, class P>
 template <class F>
 void block<T,P>::apply_ordered(F f, size_t n)
 {
-  P::executor_type::apply_ordered(f, mem_.get(), n);
+  P::executor_type::apply_ordered(f, mem_, n);
 }
 
 template <class T, class P>
 template <class F>
 void block<T,P>::apply(F f, size_t n) const
 {
-  P::executor_type::apply(f, mem_.get(), n);
+  P::executor_type::apply(f, mem_, n, P::grain_size, *part_);
 }
 
 template <class T, class P>
 template <class F>
 void block<T,P>::apply_ordered(F f, size_t n) const
 {
-  P::executor_type::apply_ordered(f, mem_.get(), n);
+  P::executor_type::apply_ordered(f, mem_, n);
 }
 
 template <class T, class P>
 template <class F>
 void block<T,P>::apply(F f, const cube_index & idx)
 {
-  P::executor_type::apply(f, mem_.get(), idx.get<0>(), idx.get<1>(), idx.get<2>());
+  apply_indexed(f, idx, layout_type{});
 }
 
 template <class T, class P>
 template <class F>
 void block<T,P>::apply_ordered(F f, const cube_index & idx)
 {
-  P::executor_type::apply_ordered(f, mem_.get(), idx.get<0>(), idx.get<1>(), idx.get<2>());
+  apply_ordered_indexed(f, idx, layout_type{});
 }
 
 template <class T, class P>
 template <class F>
 void block<T,P>::apply(F f, const cube_index & idx) const
 {
-  P::executor_type::apply(f, mem_.get(), idx.get<0>(), idx.get<1>(), idx.get<2>());
+  apply_indexed(f, idx, layout_type{});
 }
 
 template <class T, class P>
 template <class F>
 void block<T,P>::apply_ordered(F f, const cube_index & idx) const
 {
-  P::executor_type::apply_ordered(f, mem_.get(), idx.get<0>(), idx.get<1>(), idx.get<2>());
+  apply_ordered_indexed(f, idx, layout_type{});
 }
 
+template <class T, class P>
+template <class F, class C>
+void block<T,P>::apply_ordered(F f, C c, size_t n)
+{
+  P::executor_type::apply_ordered(f, c, mem_, n);
+}
+
+template <class T, class P>
+template <class F, class C>
+void block<T,P>::apply_ordered(F f, C c, size_t n) const
+{
+  P::executor_type::apply_ordered(f, c, mem_, n);
+}
+
+template <class T, class P>
+template <class F, class C>
+void block<T,P>::apply_ordered(F f, C c, const cube_index & idx)
+{
+  apply_ordered_indexed(f, c, idx, layout_type{});
+}
+
+template <class T, class P>
+template <class F, class C>
+void block<T,P>::apply_ordered(F f, C c, const cube_index & idx) const
+{
+  apply_ordered_indexed(f, c, idx, layout_type{});
+}
+
+template <class T, class P>
+template <class F>
+void block<T,P>::apply_indexed(F f, const cube_index & idx, row_major_layout) const
+{
+  P::executor_type::apply(f, mem_, idx.get<0>(), idx.get<1>(), idx.get<2>(), *part_);
+}
+
+// Other layouts split the storage range, which keeps chunks spatially compact
+template <class T, class P>
+template <class F, class L>
+void block<T,P>::apply_indexed(F f, const cube_index & idx, L) const
+{
+  T * b = mem_;
+  P::executor_type::apply_range([f,b,idx](size_t first, size_t last) {
+      L::visit([f,b](size_t p, const cube_index & i) { f(b[p], i); }, idx, first, last);
+    },
+    L::size(idx), P::grain_size, *part_
+  );
+}
+
+template <class T, class P>
+template <class F>
+void block<T,P>::apply_ordered_indexed(F f, const cube_index & idx, row_major_layout) const
+{
+  P::executor_type::apply_ordered(f, mem_, idx.get<0>(), idx.get<1>(), idx.get<2>());
+}
+
+// Ordered sweeps follow cube_index order (x fastest), whatever the layout
+template <class T, class P>
+template <class F, class L>
+void block<T,P>::apply_ordered_indexed(F f, const cube_index & idx, L) const
+{
+  T * b = mem_;
+  for_each_index(0, idx.volume(), idx.get<0>(), idx.get<1>(), [f,b,&idx](size_t q, const cube_index & i) {
+    f(b[storage_position(q, i, idx, L{})], i);
+  });
+}
+
+template <class T, class P>
+template <class F, class C>
+void block<T,P>::apply_ordered_indexed(F f, C c, const cube_index & idx, row_major_layout) const
+{
+  P::executor_type::apply_ordered(f, c, mem_, idx.get<0>(), idx.get<1>(), idx.get<2>());
+}
+
+// Results are computed in parallel over windows of fixed chunks, and passed
+// to c in cube_index order once a window is done
+template <class T, class P>
+template <class F, class C, class L>
+void block<T,P>::apply_ordered_indexed(F f, C c, const cube_index & idx, L) const
+{
+  using result_type = typename std::decay<
+      typename std::result_of<F(T&, const cube_index &)>::type>::type;
+  const size_t chunk = 1024;
+  const size_t window = 64;
+  const size_t n = idx.volume();
+  std::vector<std::vector<result_type>> results(window);
+  T * b = mem_;
+  for (size_t wfirst=0; wfirst<n; wfirst += window * chunk) {
+    const size_t wlast = std::min(n, wfirst + window * chunk);
+    P::executor_type::apply_range([f,b,&idx,&results,wfirst,wlast,chunk](size_t first, size_t last) {
+        for (size_t h=first; h!=last; ++h) {
+          const size_t qfirst = wfirst + h * chunk;
+          auto & v = results[h];
+          for_each_index(qfirst, std::min(wlast, qfirst + chunk), idx.get<0>(), idx.get<1>(),
+            [f,b,&idx,&v](size_t q, const cube_index & i) {
+              v.push_back(f(b[storage_position(q, i, idx, L{})], i));
+            });
+        }
+      },
+      (wlast - wfirst + chunk - 1) / chunk, 1, *part_
+    );
+    for (auto & v : results) {
+      for (auto & r : v) {
+        c(r);
+      }
+      v.clear();
+    }
+  }
+}
+
+// Linear positions of the cells in plane p normal to axis I.
+// visit calls f(position, cube_index) for the plane cells [first,last),
+// numbered in the order the plane is laid out in memory.
+template <int I>
+struct cube_plane;
+
+template <>
+struct cube_plane<0> {
+  static size_t size(const cube_index & idx) { return idx.get<1>() * idx.get<2>(); }
+
+  template <class F>
+  static void visit(F f, size_t p, const cube_index & idx, size_t first, size_t last) {
+    const size_t nx = idx.get<0>();
+    const size_t ny = idx.get<1>();
+    for (auto q=first; q!=last; ++q) {
+      f(p + nx * q, cube_index{p, q % ny, q / ny});
+    }
+  }
+};
+
+template <>
+struct cube_plane<1> {
+  static size_t size(const cube_index & idx) { return idx.get<0>() * idx.get<2>(); }
+
+  template <class F>
+  static void visit(F f, size_t p, const cube_index & idx, size_t first, size_t last) {
+    const size_t nx = idx.get<0>();
+    const size_t ny = idx.get<1>();
+    size_t x = first % nx;
+    size_t z = first / nx;
+    for (auto q=first; q!=last; ++q) {
+      f(nx * (z * ny + p) + x, cube_index{x, p, z});
+      if (++x == nx) {
+        x = 0;
+        ++z;
+      }
+    }
+  }
+};
+
+template <>
+struct cube_plane<2> {
+  static size_t size(const cube_index & idx) { return idx.get<0>() * idx.get<1>(); }
+
+  template <class F>
+  static void visit(F f, size_t p, const cube_index & idx, size_t first, size_t last) {
+    const size_t nx = idx.get<0>();
+    const size_t ny = idx.get<1>();
+    const size_t base = p * nx * ny;
+    for_each_index(first, last, nx, ny, [f,base,p](size_t q, const cube_index & i) {
+      f(base + q, cube_index{i.get<0>(), i.get<1>(), p});
+    });
+  }
+};
+
 template <class T, class P, int I>
 struct block_plane_traits;
 
 template <class T, class P>
 struct block_plane_traits<T,P,0> {
+  // Plane cells [first,last) lie nx apart
   template <class F>
-  static void apply_plane(F f, T * v, size_t p, const cube_index & idx) {
-    auto begin = v + p;
-    auto end = begin + idx.volume();
-    for (auto i=begin; i!=end; i+= idx.get<0>()) {
+  static void apply_plane(F f, T * v, size_t p, const cube_index & idx, size_t first, size_t last) {
+    const size_t nx = idx.get<0>();
+    auto begin = v + p + nx * first;
+    auto end = v + p + nx * last;
+    for (auto i=begin; i!=end; i+=nx) {
       f(*i);
     }
   }
+
+  static size_t size(const cube_index & idx) { return cube_plane<0>::size(idx); }
+
+  template <class F>
+  static void visit(F f, T * v, size_t p, const cube_index & idx, size_t first, size_t last) {
+    cube_plane<0>::visit([f,v,&idx](size_t q, const cube_index & i) {
+        f(v[storage_position(q, i, idx, typename P::layout_type{})], i);
+      }, p, idx, first, last);
+  }
 };
 
 template <class T, class P>
 struct block_plane_traits<T,P,1> {
+  // Plane cells [first,last) are split in x-rows, one per z
   template <class F>
-  static void apply_plane(F f, T * v, size_t p, const cube_index & idx) {
-    for (size_t z=0; z!=idx.get<2>(); ++z) {
-      auto begin = v + idx.get<0>() * (z * idx.get<1>() + p);
-      auto end = begin + idx.get<0>();
+  static void apply_plane(F f, T * v, size_t p, const cube_index & idx, size_t first, size_t last) {
+    const size_t nx = idx.get<0>();
+    const size_t ny = idx.get<1>();
+    while (first!=last) {
+      const size_t x = first % nx;
+      const size_t z = first / nx;
+      const size_t n = std::min(nx - x, last - first);
+      auto begin = v + nx * (z * ny + p) + x;
+      auto end = begin + n;
       for (auto i=begin; i!=end; ++i) {
         f(*i);
       }
+      first += n;
     }
   }
+
+  static size_t size(const cube_index & idx) { return cube_plane<1>::size(idx); }
+
+  template <class F>
+  static void visit(F f, T * v, size_t p, const cube_index & idx, size_t first, size_t last) {
+    cube_plane<1>::visit([f,v,&idx](size_t q, const cube_index & i) {
+        f(v[storage_position(q, i, idx, typename P::layout_type{})], i);
+      }, p, idx, first, last);
+  }
 };
 
 template <class T, class P>
 struct block_plane_traits<T,P,2> {
+  // The plane is contiguous
   template <class F>
-  static void apply_plane(F f, T * v, size_t p, const cube_index & idx) {
-    auto begin = v + p * idx.get<0>() * idx.get<1>();
-    auto end = begin + idx.get<0>() * idx.get<1>();
-    for (auto i=begin; i!=end; ++i) {
+  static void apply_plane(F f, T * v, size_t p, const cube_index & idx, size_t first, size_t last) {
+    auto base = v + p * idx.get<0>() * idx.get<1>();
+    auto end = base + last;
+    for (auto i=base+first; i!=end; ++i) {
       f(*i);
     }
   }
+
+  static size_t size(const cube_index & idx) { return cube_plane<2>::size(idx); }
+
+  template <class F>
+  static void visit(F f, T * v, size_t p, const cube_index & idx, size_t first, size_t last) {
+    cube_plane<2>::visit([f,v,&idx](size_t q, const cube_index & i) {
+        f(v[storage_position(q, i, idx, typename P::layout_type{})], i);
+      }, p, idx, first, last);
+  }
 };
 
+template <class T, class P>
+template <int I, class F>
+void block<T,P>::plane_range(F f, T * v, size_t p, const cube_index & idx, size_t first, size_t last, row_major_layout)
+{
+  block_plane_traits<T,P,I>::apply_plane(f, v, p, idx, first, last);
+}
+
+template <class T, class P>
+template <int I, class F, class L>
+void block<T,P>::plane_range(F f, T * v, size_t p, const cube_index & idx, size_t first, size_t last, L)
+{
+  block_plane_traits<T,P,I>::visit([&f](T & x, const cube_index &) { f(x); }, v, p, idx, first, last);
+}
+
+// Planes are split in ranges of plane cells, numbered as in cube_plane
 template <class T, class P>
 template <class F, int I>
-void block<T,P>::apply_plane(F f, size_t p, const cube_index & i)
+void block<T,P>::apply_plane(F f, size_t p, const cube_index & idx)
+{
+  T * v = mem_;
+  P::executor_type::apply_range([f,v,p,idx](size_t first, size_t last) {
+      plane_range<I>(f, v, p, idx, first, last, layout_type{});
+    },
+    block_plane_traits<T,P,I>::size(idx), P::grain_size, *part_
+  );
+}
+
+template <class T, class P>
+template <int I, class F>
+void block<T,P>::apply_plane_indexed(F f, size_t p, const cube_index & idx) const
+{
+  using traits = block_plane_traits<T,P,I>;
+  T * v = mem_;
+  P::executor_type::apply_range([f,v,p,idx](size_t first, size_t last) {
+      traits::visit(f, v, p, idx, first, last);
+    },
+    traits::size(idx), P::grain_size, *part_
+  );
+}
+
+template <class T, class P>
+template <int I>
+void block<T,P>::gather_plane(T * out, size_t p, const cube_index & idx) const
+{
+  using traits = block_plane_traits<T,P,I>;
+  T * v = mem_;
+  P::executor_type::apply_range([out,v,p,idx](size_t first, size_t last) {
+      T * o = out + first;
+      plane_range<I>([&o](const T & x) { *o++ = x; }, v, p, idx, first, last, layout_type{});
+    },
+    traits::size(idx), P::grain_size, *part_
+  );
+}
+
+template <class T, class P>
+template <int I>
+void block<T,P>::scatter_plane(const T * in, size_t p, const cube_index & idx)
+{
+  using traits = block_plane_traits<T,P,I>;
+  T * v = mem_;
+  P::executor_type::apply_range([in,v,p,idx](size_t first, size_t last) {
+      const T * q = in + first;
+      plane_range<I>([&q](T & x) { x = *q++; }, v, p, idx, first, last, layout_type{});
+    },
+    traits::size(idx), P::grain_size, *part_
+  );
+}
+
+template <class T, class P>
+template <class V, class R, class F, class M>
+V block<T,P>::transform_reduce(V init, R r, F f, size_t n, M mode) const
+{
+  T * b = mem_;
+  return P::executor_type::reduce_range(n, init, r,
+    [b,r,f](size_t first, size_t last) -> V {
+      V acc = f(b[first]);
+      for (auto i=first+1; i!=last; ++i) {
+        acc = r(acc, f(b[i]));
+      }
+      return acc;
+    },
+    mode
+  );
+}
+
+template <class T, class P>
+template <class V, class R, class F, class M>
+V block<T,P>::transform_reduce(V init, R r, F f, const cube_index & idx, M mode) const
+{
+  // Chunks of a padded layout may hold no cell at all
+  using partial = optional_partial<V>;
+  T * b = mem_;
+  return P::executor_type::reduce_range(layout_type::size(idx), partial{true, init},
+    optional_partial_combiner<V,R>{r},
+    [b,r,f,idx,init](size_t first, size_t last) -> partial {
+      partial acc{false, init};
+      layout_type::visit([b,r,f,&acc](size_t p, const cube_index & i) {
+        acc.value = acc.valid ? r(acc.value, f(b[p], i)) : f(b[p], i);
+        acc.valid = true;
+      }, idx, first, last);
+      return acc;
+    },
+    mode
+  ).value;
+}
+
+template <class T, class P>
+template <int I, class V, class R, class F, class M>
+V block<T,P>::transform_reduce_plane(V init, R r, F f, size_t p, const cube_index & idx, M mode) const
+{
+  return transform_reduce_plane_indexed<I>(init, r,
+    [f](T & x, const cube_index &) { return f(x); },
+    p, idx, mode);
+}
+
+template <class T, class P>
+template <int I, class V, class R, class F, class M>
+V block<T,P>::transform_reduce_plane_indexed(V init, R r, F f, size_t p, const cube_index & idx, M mode) const
+{
+  using traits = block_plane_traits<T,P,I>;
+  T * v = mem_;
+  return P::executor_type::reduce_range(traits::size(idx), init, r,
+    [v,r,f,p,idx,init](size_t first, size_t last) -> V {
+      V acc = init;
+      traits::visit([f,&acc](T & x, const cube_index & i) { acc = f(x,i); },
+          v, p, idx, first, first+1);
+      traits::visit([r,f,&acc](T & x, const cube_index & i) { acc = r(acc, f(x,i)); },
+          v, p, idx, first+1, last);
+      return acc;
+    },
+    mode
+  );
+}
+
+// Regions are split by x-runs, each one contiguous in a row-major layout
+template <class T, class P>
+template <class F>
+void block<T,P>::apply_region(F f, const cube_region & g, const cube_index & idx) const
+{
+  T * b = mem_;
+  P::executor_type::apply_range([f,b,g,idx](size_t first, size_t last) {
+      g.visit([f,b,&idx](size_t q, const cube_index & i) {
+          f(b[storage_position(q, i, idx, layout_type{})], i);
+        }, idx, first, last);
+    },
+    g.runs(), P::grain_size, *part_
+  );
+}
+
+template <class T, class P>
+template <class V, class R, class F, class M>
+V block<T,P>::transform_reduce_region(V init, R r, F f, const cube_region & g, const cube_index & idx, M mode) const
 {
-  block_plane_traits<T,P,I>::apply_plane(f,mem_.get(),p,i);
+  T * b = mem_;
+  return P::executor_type::reduce_range(g.runs(), init, r,
+    [b,r,f,g,idx,init](size_t first, size_t last) -> V {
+      V acc = init;
+      const size_t x0 = g.lower().get<0>();
+      g.visit_run([b,f,&idx,&acc](size_t q, const cube_index & i) {
+          acc = f(b[storage_position(q, i, idx, layout_type{})], i);
+        }, idx, first, x0, x0+1);
+      auto next = [b,r,f,&idx,&acc](size_t q, const cube_index & i) {
+          acc = r(acc, f(b[storage_position(q, i, idx, layout_type{})], i));
+        };
+      g.visit_run(next, idx, first, x0+1, g.upper().get<0>());
+      g.visit(next, idx, first+1, last);
+      return acc;
+    },
+    mode
+  );
 }
 
 }
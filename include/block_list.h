@@ -22,14 +22,34 @@ SOFTWARE.
 #ifndef YAPL_BLOCK_LIST_H
 #define YAPL_BLOCK_LIST_H
 
+#include "allocation.h"
+#include <atomic>
 #include <cstddef>
-
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
 #include <vector>
 
+// Tells the compiler that a pointer is the only way to reach its data
+#if defined(__GNUC__)
+#define YAPL_RESTRICT __restrict__
+#else
+#define YAPL_RESTRICT
+#endif
+
 namespace yapl {
 
-template <class T, class P>
+// List of elements stored in chunks of N elements.
+// Each chunk is a cache-aligned array holding its elements inline, and a
+// directory of chunk pointers gives fast access to any element and any
+// chunk. Elements never move once added.
+// The directory is split in segments that never move either, so that
+// several threads may append concurrently with concurrent_add.
+template <class T, class P, size_t N = 16>
 class block_list {
+  static_assert(N > 0, "chunks must hold at least one element");
+
 public:
 
   block_list();
@@ -44,145 +64,338 @@ public:
 
   void clear();
 
-  size_t size() const { return num_elems_; }
+  size_t size() const { return num_elems_.load(std::memory_order_relaxed); }
 
   T & at(size_t i);
+  const T & at(size_t i) const;
 
   template <class ... U>
   void add(U && ... u);
 
+  // Adds an element, and may be called from several threads at once.
+  // Each call reserves its slot with an atomic increment. The thread that
+  // gets the first slot of a chunk allocates it, and threads with other
+  // slots of that chunk wait until it is published.
+  // No other member may be used while concurrent adds are running. Once all
+  // producers have synchronized with the reader (e.g. joined), size() and
+  // the elements are consistent. Elements are stored in slot order, which
+  // is not the order of the calls.
+  // An exception during a concurrent add terminates the program, as other
+  // producers may be waiting on the chunk.
+  template <class ... U>
+  void concurrent_add(U && ... u) noexcept;
+
+  // Calls f on every element, in parallel under the policy executor.
+  // Chunks are the unit of parallel work.
   template <class F>
   void apply(F f);
 
   template <class F>
   void apply(F f) const;
 
+  // Calls bf(x,y) once for every pair where y was added before x, and then
+  // pf(x) for every element. Pairs are processed in tiles of two chunks,
+  // in parallel under the policy executor.
   template <class BF, class PF>
   void apply_cartesian_unique(BF bf, PF pf);
 
 private:
 
-  static constexpr size_t CHUNK_SIZE = 16;
-  struct chunk {
-    std::vector<T> vec_;
-    chunk * next_;
-    chunk() : vec_{}, next_{nullptr} {}
-  };
+  static constexpr size_t CHUNK_SIZE = N;
+
+  using partitioner_type = typename P::partitioner_type;
+
+  // Policy grain size, in chunks
+  static constexpr size_t grain_chunks() { return (P::grain_size + N - 1) / N; }
+
+  using chunk_allocation = aligned_allocation<(alignof(T) > 64) ? alignof(T) : 64>;
+
+  // Calls bf(x,y) for every pair with x in chunk a and y before x in chunk b
+  template <class BF>
+  void apply_tile(BF & bf, size_t a, size_t b);
+
+  // Number of elements in chunk c, out of n. Only the last chunk may be partial.
+  static size_t chunk_elems(size_t c, size_t n) {
+    return (n - c * CHUNK_SIZE < CHUNK_SIZE) ? n - c * CHUNK_SIZE : CHUNK_SIZE;
+  }
+
+  size_t num_chunks() const { return (size() + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+
+  // Directory segment s holds DIR_BASE << s chunk pointers, and starts at
+  // chunk DIR_BASE * (2^s - 1).
+  static constexpr size_t DIR_BASE = 8;
+  static constexpr size_t DIR_SEGMENTS = 32;
+
+  using chunk_slot = std::atomic<T*>;
+
+  static size_t segment_of(size_t c);
+  static size_t segment_start(size_t s) { return DIR_BASE * ((size_t{1} << s) - 1); }
+
+  // Directory slot of chunk c, allocating its segment if needed
+  chunk_slot & slot(size_t c);
+
+  // Chunk c, which must have been published
+  T * chunk(size_t c) const;
+
+  // Allocates chunk c unless it is already there, and publishes it
+  T * new_chunk(size_t c);
+
+  // Waits until chunk c is published by another thread
+  T * wait_chunk(size_t c);
 
-  chunk * first_;
-  chunk * last_;
-  size_t num_elems_;
+  std::atomic<chunk_slot*> segments_[DIR_SEGMENTS];
+  std::atomic<size_t> num_elems_;
+  // Kept across calls, so that stateful partitioners can replay their mapping
+  std::unique_ptr<partitioner_type> part_;
 };
 
-template <class T, class P>
-constexpr size_t block_list<T,P>::CHUNK_SIZE;
+template <class T, class P, size_t N>
+constexpr size_t block_list<T,P,N>::CHUNK_SIZE;
 
-template <class T, class P>
-block_list<T,P>::block_list()
+template <class T, class P, size_t N>
+constexpr size_t block_list<T,P,N>::DIR_BASE;
+
+template <class T, class P, size_t N>
+constexpr size_t block_list<T,P,N>::DIR_SEGMENTS;
+
+template <class T, class P, size_t N>
+block_list<T,P,N>::block_list()
 :
-first_{nullptr},
-last_{nullptr},
-num_elems_{0}
+num_elems_{0},
+part_{new partitioner_type{}}
 {
+  for (auto & seg : segments_) {
+    seg.store(nullptr, std::memory_order_relaxed);
+  }
 }
 
-template <class T, class P>
-block_list<T,P>::~block_list()
+template <class T, class P, size_t N>
+block_list<T,P,N>::~block_list()
 {
   clear();
+  for (auto & seg : segments_) {
+    delete [] seg.load(std::memory_order_relaxed);
+  }
 }
 
-template <class T, class P>
-void block_list<T,P>::clear()
+template <class T, class P, size_t N>
+void block_list<T,P,N>::clear()
 {
-  while (first_ != nullptr) {
-    chunk * tmp = first_;
-    first_ = first_->next_;
-    delete tmp;
+  // Segments are kept for reuse. A chunk may be allocated past the last
+  // element if its first construction threw.
+  const size_t n = size();
+  const size_t nchunks = num_chunks();
+  for (size_t s=0; s!=DIR_SEGMENTS; ++s) {
+    chunk_slot * seg = segments_[s].load(std::memory_order_relaxed);
+    if (seg == nullptr) continue;
+    for (size_t k=0; k!=(DIR_BASE << s); ++k) {
+      T * p = seg[k].load(std::memory_order_relaxed);
+      if (p == nullptr) continue;
+      const size_t c = segment_start(s) + k;
+      const size_t ne = (c < nchunks) ? chunk_elems(c, n) : 0;
+      for (auto i=p, end=p+ne; i!=end; ++i) {
+        i->~T();
+      }
+      chunk_allocation{}.deallocate(p, CHUNK_SIZE);
+      seg[k].store(nullptr, std::memory_order_relaxed);
+    }
   }
-  last_ = nullptr;
-  num_elems_ = 0;
+  num_elems_.store(0, std::memory_order_relaxed);
 }
 
-template <class T, class P>
+template <class T, class P, size_t N>
 template <class ... U>
-void block_list<T,P>::add(U && ... u)
+void block_list<T,P,N>::add(U && ... u)
 {
-  const size_t offset = num_elems_ % CHUNK_SIZE;
-  if (offset == 0) {
-    chunk * tmp = new chunk;
-    if (first_ == nullptr) {
-      first_ = tmp;
-    }
-    else {
-      last_->next_ = tmp;
-    }
-    last_ = tmp;
-  }
-  //new (&last_->vec_[offset]) T{u...};
-  last_->vec_.emplace_back(std::forward<U>(u)...);
-  num_elems_++;
+  const size_t i = size();
+  T * p = (i % CHUNK_SIZE == 0) ? new_chunk(i / CHUNK_SIZE) : chunk(i / CHUNK_SIZE);
+  new (p + i % CHUNK_SIZE) T(std::forward<U>(u)...);
+  num_elems_.store(i + 1, std::memory_order_relaxed);
 }
 
-template <class T, class P>
-T & block_list<T,P>::at(size_t i)
+template <class T, class P, size_t N>
+template <class ... U>
+void block_list<T,P,N>::concurrent_add(U && ... u) noexcept
 {
-  const size_t offset = i % CHUNK_SIZE;
-  const size_t block_id = i / CHUNK_SIZE;
-  chunk * current = first_;
-  for (size_t i=0;i!=block_id;++i) {
-    current = current->next_;
-  }
-  return current->vec_[offset];
+  const size_t i = num_elems_.fetch_add(1, std::memory_order_relaxed);
+  T * p = (i % CHUNK_SIZE == 0) ? new_chunk(i / CHUNK_SIZE) : wait_chunk(i / CHUNK_SIZE);
+  new (p + i % CHUNK_SIZE) T(std::forward<U>(u)...);
+}
+
+template <class T, class P, size_t N>
+T & block_list<T,P,N>::at(size_t i)
+{
+  return chunk(i / CHUNK_SIZE)[i % CHUNK_SIZE];
 }
 
-template <class T, class P>
+template <class T, class P, size_t N>
+const T & block_list<T,P,N>::at(size_t i) const
+{
+  return chunk(i / CHUNK_SIZE)[i % CHUNK_SIZE];
+}
+
+template <class T, class P, size_t N>
 template <class F>
-void block_list<T,P>::apply(F f)
+void block_list<T,P,N>::apply(F f)
 {
-  for (auto pblock = first_; pblock != nullptr; pblock = pblock->next_) {
-    size_t nblock = (pblock == last_)?num_elems_ % CHUNK_SIZE: CHUNK_SIZE;
-    auto end = pblock->vec_.data() + nblock;
-    for (auto i=pblock->vec_.data(); i!=end;++i) {
-      f(*i);
-    }
-  }
+  const block_list * self = this;
+  const size_t n = size();
+  P::executor_type::apply_range([f,self,n](size_t first, size_t last) {
+      for (size_t c=first; c!=last; ++c) {
+        auto begin = self->chunk(c);
+        auto end = begin + chunk_elems(c, n);
+        for (auto i=begin; i!=end; ++i) {
+          f(*i);
+        }
+      }
+    },
+    num_chunks(), grain_chunks(), *part_
+  );
 }
 
-template <class T, class P>
+template <class T, class P, size_t N>
 template <class F>
-void block_list<T,P>::apply(F f) const
+void block_list<T,P,N>::apply(F f) const
 {
-  for (auto pblock = first_; pblock != nullptr; pblock = pblock->next_) {
-    size_t nblock = (pblock == last_)?num_elems_ % CHUNK_SIZE: CHUNK_SIZE;
-    auto end = pblock->vec_.data() + nblock;
-    for (auto i=pblock->vec_.data(); i!=end;++i) {
-      f(*i);
-    }
-  }
+  const block_list * self = this;
+  const size_t n = size();
+  P::executor_type::apply_range([f,self,n](size_t first, size_t last) {
+      for (size_t c=first; c!=last; ++c) {
+        const T * begin = self->chunk(c);
+        auto end = begin + chunk_elems(c, n);
+        for (auto i=begin; i!=end; ++i) {
+          f(*i);
+        }
+      }
+    },
+    num_chunks(), grain_chunks(), *part_
+  );
 }
 
-template <class T, class P>
+template <class T, class P, size_t N>
 template <class BF, class PF>
-void block_list<T,P>::apply_cartesian_unique(BF bf, PF pf)
-{
-  for (auto pblock = first_; pblock != nullptr; pblock=pblock->next_) {
-    size_t nblock = (pblock == last_) ? num_elems_ % CHUNK_SIZE: CHUNK_SIZE;
-    auto end = pblock->vec_.data() + nblock;
-    for (auto i=pblock->vec_.data(); i!=end; ++i) {
-      for (chunk * pblock2 = first_; pblock2 != pblock->next_; pblock2=pblock2->next_) {
-        size_t nblock2 = (pblock2 == pblock) ? i-pblock->vec_.data() : CHUNK_SIZE;
-        auto end2 = pblock2->vec_.data() + nblock2;
-        for (auto j=pblock2->vec_.data(); j!=end2; ++j) {
-          bf(*i,*j);
+void block_list<T,P,N>::apply_cartesian_unique(BF bf, PF pf)
+{
+  const size_t nchunks = num_chunks();
+  // Round r holds the tiles (a,b), b<=a, with a+b = r (mod nchunks).
+  // Every chunk is in exactly one tile of a round, so the tiles of a round
+  // touch disjoint chunks and run in parallel without conflicts.
+  std::vector<std::pair<size_t,size_t>> tiles;
+  tiles.reserve(nchunks / 2 + 1);
+  for (size_t r=0; r!=nchunks; ++r) {
+    tiles.clear();
+    for (size_t a=0; a!=nchunks; ++a) {
+      const size_t b = (r + nchunks - a) % nchunks;
+      if (b <= a) tiles.emplace_back(a,b);
+    }
+    block_list * self = this;
+    const std::pair<size_t,size_t> * ptiles = tiles.data();
+    P::executor_type::apply_range([bf,self,ptiles](size_t first, size_t last) {
+        BF g = bf;
+        for (size_t t=first; t!=last; ++t) {
+          self->apply_tile(g, ptiles[t].first, ptiles[t].second);
         }
+      },
+      tiles.size(), 1, *part_
+    );
+  }
+
+  apply(pf);
+}
+
+template <class T, class P, size_t N>
+template <class BF>
+void block_list<T,P,N>::apply_tile(BF & bf, size_t a, size_t b)
+{
+  T * YAPL_RESTRICT pa = chunk(a);
+  T * YAPL_RESTRICT pb = chunk(b);
+  const size_t na = chunk_elems(a, size());
+  if (a == b) {
+    for (size_t i=1; i<na; ++i) {
+      T & x = pa[i];
+      for (size_t j=0; j!=i; ++j) {
+        bf(x, pa[j]);
+      }
+    }
+  }
+  else {
+    // Chunk b precedes chunk a, so it is full. Distinct chunks never
+    // overlap, which pa and pb tell the compiler.
+    for (size_t i=0; i!=na; ++i) {
+      T & x = pa[i];
+      for (size_t j=0; j!=CHUNK_SIZE; ++j) {
+        bf(x, pb[j]);
       }
+    }
+  }
+}
 
-      pf(*i);
+template <class T, class P, size_t N>
+size_t block_list<T,P,N>::segment_of(size_t c)
+{
+  // floor(log2(c / DIR_BASE + 1))
+  const size_t q = c / DIR_BASE + 1;
+#if defined(__GNUC__)
+  return sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(q);
+#else
+  size_t s = 0;
+  while (q >> (s+1)) ++s;
+  return s;
+#endif
+}
+
+template <class T, class P, size_t N>
+typename block_list<T,P,N>::chunk_slot & block_list<T,P,N>::slot(size_t c)
+{
+  const size_t s = segment_of(c);
+  chunk_slot * seg = segments_[s].load(std::memory_order_acquire);
+  if (seg == nullptr) {
+    // Several threads may race to allocate a segment. Only one succeeds.
+    chunk_slot * fresh = new chunk_slot[DIR_BASE << s]();
+    if (segments_[s].compare_exchange_strong(seg, fresh, std::memory_order_acq_rel)) {
+      seg = fresh;
+    }
+    else {
+      delete [] fresh;
     }
   }
+  return seg[c - segment_start(s)];
 }
 
+template <class T, class P, size_t N>
+T * block_list<T,P,N>::chunk(size_t c) const
+{
+  const size_t s = segment_of(c);
+  return segments_[s].load(std::memory_order_relaxed)[c - segment_start(s)]
+      .load(std::memory_order_relaxed);
 }
 
+template <class T, class P, size_t N>
+T * block_list<T,P,N>::new_chunk(size_t c)
+{
+  chunk_slot & sl = slot(c);
+  T * p = sl.load(std::memory_order_relaxed);
+  if (p == nullptr) {
+    p = chunk_allocation{}.template allocate<T>(CHUNK_SIZE);
+    sl.store(p, std::memory_order_release);
+  }
+  return p;
+}
+
+template <class T, class P, size_t N>
+T * block_list<T,P,N>::wait_chunk(size_t c)
+{
+  chunk_slot & sl = slot(c);
+  T * p = sl.load(std::memory_order_acquire);
+  while (p == nullptr) {
+    std::this_thread::yield();
+    p = sl.load(std::memory_order_acquire);
+  }
+  return p;
+}
+
+}
+
+#undef YAPL_RESTRICT
+
 #endif
@@ -0,0 +1,87 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_BOUNDARY_H
+#define YAPL_BOUNDARY_H
+
+#include <cstddef>
+
+// Boundary policies giving the value of cells outside a cube.
+// map(x,n) receives a coordinate x outside [0,n) on one axis. It either moves
+// x into [0,n) and returns true, so the cell copies that interior cell, or
+// returns false, so the cell is set by assign(cell).
+
+namespace yapl {
+
+// Cells outside the cube are value-initialized
+struct zero_boundary {
+  bool map(std::ptrdiff_t &, std::ptrdiff_t) const { return false; }
+
+  template <class T>
+  void assign(T & x) const { x = T{}; }
+};
+
+// Cells outside the cube are copies of a fixed value
+template <class T>
+class copy_boundary {
+public:
+  explicit copy_boundary(const T & v) : value_{v} {}
+
+  bool map(std::ptrdiff_t &, std::ptrdiff_t) const { return false; }
+
+  template <class U>
+  void assign(U & x) const { x = value_; }
+
+private:
+  T value_;
+};
+
+template <class T>
+copy_boundary<T> make_copy_boundary(const T & v)
+{
+  return copy_boundary<T>{v};
+}
+
+// Cells outside the cube take the value of the nearest cell in the cube
+struct clamp_boundary {
+  bool map(std::ptrdiff_t & x, std::ptrdiff_t n) const {
+    x = (x < 0) ? 0 : n - 1;
+    return true;
+  }
+
+  template <class T>
+  void assign(T &) const {}
+};
+
+// Cells outside the cube take the value of the cell wrapped around the cube
+struct periodic_boundary {
+  bool map(std::ptrdiff_t & x, std::ptrdiff_t n) const {
+    x = ((x % n) + n) % n;
+    return true;
+  }
+
+  template <class T>
+  void assign(T &) const {}
+};
+
+}
+
+#endif
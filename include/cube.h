@@ -29,6 +29,7 @@ SOFTWARE.
 #include <type_traits>
 #include <iostream>
 #include <algorithm>
+#include <utility>
 
 #ifndef NDEBUG
 #include <cassert>
@@ -47,12 +48,25 @@ public:
   template <int I,typename RT>
   using requires_dim = typename std::enable_if<I>=0 && I<3,RT>::type;
 
+public:
+  using layout_type = typename P::layout_type;
+  using reference = typename block<T,P>::reference;
+  using const_reference = typename block<T,P>::const_reference;
+
 public:
   cube() = delete;
 
   cube(size_t nx, size_t ny, size_t nz);
   cube(const cube_index & i);
 
+  // Extra arguments are passed to the block constructor
+  // (e.g. first_touch_init, no_init or an allocation object)
+  template <class ... A>
+  cube(size_t nx, size_t ny, size_t nz, A && ... a);
+
+  template <class ... A>
+  cube(const cube_index & i, A && ... a);
+
   // No copy allowed
   cube(const cube &) = delete;
   cube & operator=(const cube &) = delete;
@@ -69,6 +83,8 @@ public:
 
   cube_index size() const { return sizes_; }
 
+  const typename block<T,P>::allocation_type & get_allocation() const { return grid_.get_allocation(); }
+
   template <int I>
   requires_dim<I,size_t> size() const { return sizes_.get<I>(); }
 
@@ -81,12 +97,34 @@ public:
   template <int I>
   requires_dim<I,plane_cube_mapping<block<T,P>,I>> plane(size_t p) { return {&grid_, p, size<0>(), size<1>(), size<2>()}; }
 
+  // Mapping over the box of cells [lo,hi)
+  region_cube_mapping<block<T,P>> region(const cube_index & lo, const cube_index & hi);
+  const_region_cube_mapping<block<T,P>> region(const cube_index & lo, const cube_index & hi) const;
+
+  // Mapping over a single field of a structure of arrays cube (see soa.h)
+  template <size_t I, class B = block<T,P>>
+  full_cube_mapping<typename B::template field_block_type<I>> field() { return {&grid_.template field<I>(), sizes_}; }
+
+  template <size_t I, class B = block<T,P>>
+  const_full_cube_mapping<typename B::template field_block_type<I>> field() const { return {&grid_.template field<I>(), sizes_}; }
+
+  // Periodic axes wrap neighbour traversal around the cube.
+  // Every periodic axis needs at least 3 cells.
+  void set_periodic(bool x, bool y, bool z);
+
+  template <int I>
+  requires_dim<I,bool> periodic() const { return periodic_[I]; }
+
   template <typename F>
   void for_all_neighbours(size_t i, size_t j, size_t k, F f);
 
   template <typename F>
   void for_all_neighbours(const cube_index & i, F f);
 
+  // Calls f(cell, shift) with the periodic images crossed to reach the cell
+  template <typename F>
+  void for_all_neighbours_shifted(const cube_index & i, F f);
+
   template <typename F>
   void for_all_neighbours_unique(size_t i, size_t j, size_t k, F f);
 
@@ -95,13 +133,46 @@ public:
 
   T ** fill_neighbours_unique(size_t i, size_t j, size_t k, T ** it);
 
+  template <typename F>
+  void for_all_neighbours_unique_shifted(const cube_index & i, F f);
+
   T ** fill_neighbours_unique(const cube_index & i, T ** it);
 
-  T & operator()(size_t i, size_t j, size_t k);
-  T operator()(size_t i, size_t j, size_t k) const;
+  // Also stores the shift of every neighbour in shifts
+  T ** fill_neighbours_unique(const cube_index & i, T ** it, cube_shift * shifts);
+
+  // Calls f(cell, neighbour) once for every pair of neighbour cells, in
+  // parallel. Cells are coloured so that concurrent calls never share a
+  // cell, and f may update both cells without locks.
+  template <typename F>
+  void apply_cell_pairs(F f);
+
+  // Calls f(cell, neighbour, shift) with the shift of the neighbour
+  template <typename F>
+  void apply_cell_pairs_shifted(F f);
+
+  // True if the cell has all its 26 neighbours inside the cube
+  bool interior(size_t i, size_t j, size_t k) const;
+
+  // Linear offsets of the neighbours of an interior cell, in traversal order.
+  // Kernels may use them to prefetch neighbour cells. Row-major layout only.
+  template <class L = layout_type>
+  const std::ptrdiff_t * neighbour_offsets() const;
+
+  template <class L = layout_type>
+  const std::ptrdiff_t * unique_neighbour_offsets() const;
+
+  reference operator()(size_t i, size_t j, size_t k);
+  const_reference operator()(size_t i, size_t j, size_t k) const;
 
-  T & operator()(const cube_index & i);
-  T operator()(const cube_index & i) const;
+  reference operator()(const cube_index & i);
+  const_reference operator()(const cube_index & i) const;
+
+  using partitioner_type = typename P::partitioner_type;
+
+  // Partitioner kept across the sweeps of this cube, for algorithms that
+  // run their own parallel sweeps over it (e.g. apply_stencil)
+  partitioner_type & partitioner() { return *part_; }
 
   friend std::ostream & operator<< <>(std::ostream & os, const cube & c);
 
@@ -109,10 +180,34 @@ private:
   size_t index(size_t i, size_t j, size_t k) const;
   size_t index(const cube_index & i) const;
 
+  void init_offsets();
+
+  // Coordinate x of the neighbour at offset d from i on an axis, with the
+  // periodic images crossed. False if there is no such neighbour.
+  bool neighbour_coordinate(size_t i, int d, int axis, size_t & x, int & shift) const;
+
+  // Calls g(cell, shift) for every (unique) neighbour
+  template <bool Unique, typename G>
+  void visit_neighbours(size_t i, size_t j, size_t k, G g);
+
+  // Coordinates of one colour along an axis
+  struct colour_stripe {
+    size_t first, step, count;
+  };
+
+  // Along an axis coordinates are coloured modulo a period. On periodic
+  // axes trailing cells that do not fill a whole period get their own colour.
+  static size_t colours(size_t n, size_t period, bool periodic);
+  static colour_stripe stripe(size_t c, size_t n, size_t period, bool periodic);
+
 private:
   cube_index sizes_;
   size_t nelems_;
   block<T,P> grid_;
+  bool periodic_[3];
+  std::ptrdiff_t all_offsets_[26];
+  std::ptrdiff_t unique_offsets_[13];
+  std::unique_ptr<partitioner_type> part_;
 };
 
 template <class T, class P>
@@ -125,18 +220,50 @@ template <class T, class P>
 cube<T,P>::cube(size_t nx, size_t ny, size_t nz)
 :
 sizes_{nx,ny,nz},
-nelems_{nx*ny*nz},
-grid_{nelems_}
+nelems_{layout_type::size(cube_index{nx,ny,nz})},
+grid_{nelems_},
+periodic_{false,false,false},
+part_{new partitioner_type{}}
 {
+  init_offsets();
 }
 
 template <class T, class P>
 cube<T,P>::cube(const cube_index & i)
 :
 sizes_{i},
-nelems_{i.get<0>() * i.get<1>() * i.get<2>()},
-grid_{nelems_}
+nelems_{layout_type::size(i)},
+grid_{nelems_},
+periodic_{false,false,false},
+part_{new partitioner_type{}}
+{
+  init_offsets();
+}
+
+template <class T, class P>
+template <class ... A>
+cube<T,P>::cube(size_t nx, size_t ny, size_t nz, A && ... a)
+:
+sizes_{nx,ny,nz},
+nelems_{layout_type::size(cube_index{nx,ny,nz})},
+grid_{nelems_, std::forward<A>(a)...},
+periodic_{false,false,false},
+part_{new partitioner_type{}}
 {
+  init_offsets();
+}
+
+template <class T, class P>
+template <class ... A>
+cube<T,P>::cube(const cube_index & i, A && ... a)
+:
+sizes_{i},
+nelems_{layout_type::size(i)},
+grid_{nelems_, std::forward<A>(a)...},
+periodic_{false,false,false},
+part_{new partitioner_type{}}
+{
+  init_offsets();
 }
 
 template <class T, class P>
@@ -145,128 +272,247 @@ void cube<T,P>::swap(cube & c)
   std::swap(sizes_, c.sizes_);
   std::swap(nelems_, c.nelems_);
   std::swap(grid_, c.grid_);
+  std::swap(periodic_, c.periodic_);
+  std::swap(all_offsets_, c.all_offsets_);
+  std::swap(unique_offsets_, c.unique_offsets_);
+  std::swap(part_, c.part_);
+}
+
+template <class T, class P>
+region_cube_mapping<block<T,P>> cube<T,P>::region(const cube_index & lo, const cube_index & hi)
+{
+#ifndef NDEBUG
+  assert(lo.get<0>()<=hi.get<0>() && hi.get<0>()<=size_x());
+  assert(lo.get<1>()<=hi.get<1>() && hi.get<1>()<=size_y());
+  assert(lo.get<2>()<=hi.get<2>() && hi.get<2>()<=size_z());
+#endif
+  return {&grid_, sizes_, cube_region{lo,hi}};
+}
+
+template <class T, class P>
+const_region_cube_mapping<block<T,P>> cube<T,P>::region(const cube_index & lo, const cube_index & hi) const
+{
+#ifndef NDEBUG
+  assert(lo.get<0>()<=hi.get<0>() && hi.get<0>()<=size_x());
+  assert(lo.get<1>()<=hi.get<1>() && hi.get<1>()<=size_y());
+  assert(lo.get<2>()<=hi.get<2>() && hi.get<2>()<=size_z());
+#endif
+  return {&grid_, sizes_, cube_region{lo,hi}};
+}
+
+template <class T, class P>
+void cube<T,P>::set_periodic(bool x, bool y, bool z)
+{
+#ifndef NDEBUG
+  // Smaller periodic axes would make a cell its own neighbour
+  assert(!x || size_x()>=3);
+  assert(!y || size_y()>=3);
+  assert(!z || size_z()>=3);
+#endif
+  periodic_[0] = x;
+  periodic_[1] = y;
+  periodic_[2] = z;
 }
 
 template <class T, class P>
 template <typename F>
-void cube<T,P>::for_all_neighbours(size_t i, size_t j, size_t k, F f)
+void cube<T,P>::apply_cell_pairs(F f)
 {
-  size_t xmin = std::max(0, int(i-1));
-  size_t ymin = std::max(0, int(j-1));
-  size_t zmin = std::max(0, int(k-1));
-  size_t xmax = std::min(i+1, size_x());
-  size_t ymax = std::min(j+1, size_y());
-  size_t zmax = std::min(k+1, size_z());
-  for (size_t z=zmin;z<=zmax;++z) {
-    for (size_t y=ymin;y<=ymax;++y) {
-      for (size_t x=xmin;x<=xmax;x++) {
-        if (x==i && y==j && z==k) continue;
-        f(grid_[index(x,y,z)]);
+  apply_cell_pairs_shifted([f](reference a, reference b, const cube_shift &) { f(a,b); });
+}
+
+template <class T, class P>
+template <typename F>
+void cube<T,P>::apply_cell_pairs_shifted(F f)
+{
+  // A cell touches the half-shell [-1,1]x[-1,1]x[-1,0]. Cells of the same
+  // colour are 3 apart in x and y and 2 apart in z, so they never touch
+  // the same cell.
+  const size_t ncx = colours(size_x(), 3, periodic_[0]);
+  const size_t ncy = colours(size_y(), 3, periodic_[1]);
+  const size_t ncz = colours(size_z(), 2, periodic_[2]);
+  for (size_t cz=0; cz<ncz; ++cz) {
+    const colour_stripe sz = stripe(cz, size_z(), 2, periodic_[2]);
+    for (size_t cy=0; cy<ncy; ++cy) {
+      const colour_stripe sy = stripe(cy, size_y(), 3, periodic_[1]);
+      for (size_t cx=0; cx<ncx; ++cx) {
+        const colour_stripe sx = stripe(cx, size_x(), 3, periodic_[0]);
+        const size_t n = sx.count * sy.count * sz.count;
+        if (n==0) continue;
+        P::executor_type::apply_range([this,f,sx,sy,sz](size_t first, size_t last) {
+          for (size_t r=first; r!=last; ++r) {
+            const size_t i = sx.first + (r % sx.count) * sx.step;
+            const size_t j = sy.first + ((r / sx.count) % sy.count) * sy.step;
+            const size_t k = sz.first + (r / (sx.count * sy.count)) * sz.step;
+            reference c = grid_[index(i,j,k)];
+            visit_neighbours<true>(i, j, k, [&f,&c](reference x, const cube_shift & s) { f(c, x, s); });
+          }
+        }, n, P::grain_size, *part_);
       }
     }
   }
 }
 
 template <class T, class P>
-template <typename F>
-void cube<T,P>::for_all_neighbours(const cube_index & i, F f)
+size_t cube<T,P>::colours(size_t n, size_t period, bool periodic)
 {
-  cube_index imin = i.bound_lower(cube_index{0,0,0});
-  cube_index imax = i.bound_upper(size());
-  for (size_t z=imin.get<2>(); z<=imax.get<2>(); ++z) {
-    for (size_t y=imin.get<1>(); y<=imax.get<1>(); ++y) {
-      for (size_t x=imin.get<0>(); x<=imax.get<0>(); ++x) {
-        cube_index current{x,y,z};
-        if (current == i) continue;
-        f(grid_[index(current)]);
-      }
+  return periodic ? period + n % period : period;
+}
+
+template <class T, class P>
+typename cube<T,P>::colour_stripe cube<T,P>::stripe(size_t c, size_t n, size_t period, bool periodic)
+{
+  const size_t limit = periodic ? n - n % period : n;
+  if (c>=period) return {limit + c - period, 1, 1};
+  return {c, period, (c<limit) ? (limit - c + period - 1) / period : 0};
+}
+
+template <class T, class P>
+bool cube<T,P>::interior(size_t i, size_t j, size_t k) const
+{
+  return i-1 < size_x()-2 && j-1 < size_y()-2 && k-1 < size_z()-2;
+}
+
+template <class T, class P>
+template <class L>
+const std::ptrdiff_t * cube<T,P>::neighbour_offsets() const
+{
+  static_assert(std::is_same<L, row_major_layout>::value, "Neighbour offsets need a row-major layout");
+  return all_offsets_;
+}
+
+template <class T, class P>
+template <class L>
+const std::ptrdiff_t * cube<T,P>::unique_neighbour_offsets() const
+{
+  static_assert(std::is_same<L, row_major_layout>::value, "Neighbour offsets need a row-major layout");
+  return unique_offsets_;
+}
+
+template <class T, class P>
+void cube<T,P>::init_offsets()
+{
+  const std::ptrdiff_t sy = size_x();
+  const std::ptrdiff_t sz = size_x() * size_y();
+  std::transform(neighbour_shell, neighbour_shell + 26, all_offsets_,
+    [=](neighbour_offset o) { return linear_offset(o, sy, sz); });
+  std::transform(neighbour_half_shell, neighbour_half_shell + 13, unique_offsets_,
+    [=](neighbour_offset o) { return linear_offset(o, sy, sz); });
+}
+
+template <class T, class P>
+bool cube<T,P>::neighbour_coordinate(size_t i, int d, int axis, size_t & x, int & shift) const
+{
+  const size_t n = (axis==0) ? size_x() : (axis==1) ? size_y() : size_z();
+  shift = 0;
+  if (d<0 && i==0) {
+    if (!periodic_[axis]) return false;
+    x = n-1;
+    shift = -1;
+  }
+  else if (d>0 && i==n-1) {
+    if (!periodic_[axis]) return false;
+    x = 0;
+    shift = 1;
+  }
+  else {
+    x = i + d;
+  }
+  return true;
+}
+
+template <class T, class P>
+template <bool Unique, typename G>
+void cube<T,P>::visit_neighbours(size_t i, size_t j, size_t k, G g)
+{
+  const neighbour_offset * first = Unique ? neighbour_half_shell : neighbour_shell;
+  const neighbour_offset * last = first + (Unique ? 13 : 26);
+  if (std::is_same<layout_type, row_major_layout>::value && interior(i,j,k)) {
+    // Interior cells need no bound checks nor wrapping
+    const size_t base = index(i,j,k);
+    const std::ptrdiff_t * d = Unique ? unique_offsets_ : all_offsets_;
+    for (; first!=last; ++first, ++d) {
+      g(grid_[base + *d], cube_shift{0,0,0});
+    }
+    return;
+  }
+
+  size_t x, y, z;
+  int sx, sy, sz;
+  for (; first!=last; ++first) {
+    if (neighbour_coordinate(i, first->dx, 0, x, sx) &&
+        neighbour_coordinate(j, first->dy, 1, y, sy) &&
+        neighbour_coordinate(k, first->dz, 2, z, sz)) {
+      g(grid_[index(x,y,z)], cube_shift{sx,sy,sz});
     }
   }
 }
 
+template <class T, class P>
+template <typename F>
+void cube<T,P>::for_all_neighbours(size_t i, size_t j, size_t k, F f)
+{
+  visit_neighbours<false>(i, j, k, [&f](reference x, const cube_shift &) { f(x); });
+}
+
+template <class T, class P>
+template <typename F>
+void cube<T,P>::for_all_neighbours(const cube_index & i, F f)
+{
+  for_all_neighbours(i.get<0>(), i.get<1>(), i.get<2>(), f);
+}
+
+template <class T, class P>
+template <typename F>
+void cube<T,P>::for_all_neighbours_shifted(const cube_index & i, F f)
+{
+  visit_neighbours<false>(i.get<0>(), i.get<1>(), i.get<2>(), f);
+}
+
 template <class T, class P>
 template <typename F>
 void cube<T,P>::for_all_neighbours_unique(size_t i, size_t j, size_t k, F f)
-{                                      
-  size_t xmin = std::max(0, int(i-1)); 
-  size_t ymin = std::max(0, int(j-1));
-  size_t zmin = std::max(0, int(k-1));
-  size_t xmax = std::min(i+1, size_x());
-  size_t ymax = std::min(j+1, size_y());
-  size_t zmax = std::min(k, size_z());
-  for (size_t x=xmin;x<=xmax;x++) {
-    for (size_t y=ymin;y<=ymax;++y) {
-      for (size_t z=zmin;z<=zmax;++z) {
-        if (y==j+1 && z==k) continue; 
-        if (x==i+1 && y==j && z==k) continue;
-        if (x==i && y==j && z==k) continue;
-        f(grid_[index(x,y,z)]);
-      }
-    }
-  }
+{
+  visit_neighbours<true>(i, j, k, [&f](reference x, const cube_shift &) { f(x); });
 }
 
 template <class T, class P>
 template <typename F>
 void cube<T,P>::for_all_neighbours_unique(const cube_index & i, F f)
-{                                      
-  cube_index imin = i.bound_lower(cube_index{0,0,0});
-  cube_index imax = i.bound_upper_unique(size());
-  for (size_t x=imin.get<0>(); x<=imax.get<0>(); ++x) {
-    for (size_t y=imin.get<1>(); y<=imax.get<1>(); ++y) {
-      for (size_t z=imin.get<2>(); z<=imax.get<2>(); ++z) {
-        if (y==i.get<1>()+1 && z==i.get<2>()) continue; 
-        if (x==i.get<0>()+1 && y==i.get<1>() && z==i.get<2>()) continue;
-        cube_index current{x,y,z};
-        if (current == i) continue;
-        f(grid_[index(current)]);
-      }
-    }
-  }
+{
+  for_all_neighbours_unique(i.get<0>(), i.get<1>(), i.get<2>(), f);
+}
+
+template <class T, class P>
+template <typename F>
+void cube<T,P>::for_all_neighbours_unique_shifted(const cube_index & i, F f)
+{
+  visit_neighbours<true>(i.get<0>(), i.get<1>(), i.get<2>(), f);
 }
 
 template <class T, class P>
 T ** cube<T,P>::fill_neighbours_unique(size_t i, size_t j, size_t k, T ** it) {
-  size_t xmin = std::max(0, int(i-1)); 
-  size_t ymin = std::max(0, int(j-1));
-  size_t zmin = std::max(0, int(k-1));
-  size_t xmax = std::min(i+1, size_x());
-  size_t ymax = std::min(j+1, size_y());
-  size_t zmax = std::min(k, size_z());
-  for (size_t x=xmin;x<=xmax;x++) {
-    for (size_t y=ymin;y<=ymax;++y) {
-      for (size_t z=zmin;z<=zmax;++z) {
-        if (y==j+1 && z==k) continue; 
-        if (x==i+1 && y==j && z==k) continue;
-        if (x==i && y==j && z==k) continue;
-        *it++ = &grid_[index(x,y,z)];
-      }
-    }
-  }
+  visit_neighbours<true>(i, j, k, [&it](T & x, const cube_shift &) { *it++ = &x; });
   return it;
 }
 
 template <class T, class P>
 T ** cube<T,P>::fill_neighbours_unique(const cube_index & idx, T ** it) {
-  cube_index imin = idx.bound_lower(cube_index{0,0,0}); 
-  cube_index imax = idx.bound_upper_unique(size()); 
-  for (size_t x=imin.get<0>(); x<=imax.get<0>(); x++) {
-    for (size_t y=imin.get<1>(); y<=imax.get<1>(); ++y) {
-      for (size_t z=imin.get<2>(); z<=imax.get<2>(); ++z) {
-        if (y==idx.get<1>()+1 && z==idx.get<2>()) continue; 
-        if (x==idx.get<0>()+1 && y==idx.get<1>() && z==idx.get<2>()) continue;
-
-        cube_index current{x,y,z};
-        if (current == idx) continue;
-        *it++ = &grid_[index(current)];
-      }
-    }
-  }
+  return fill_neighbours_unique(idx.get<0>(), idx.get<1>(), idx.get<2>(), it);
+}
+
+template <class T, class P>
+T ** cube<T,P>::fill_neighbours_unique(const cube_index & idx, T ** it, cube_shift * shifts) {
+  visit_neighbours<true>(idx.get<0>(), idx.get<1>(), idx.get<2>(),
+    [&it,&shifts](T & x, const cube_shift & s) {
+      *it++ = &x;
+      *shifts++ = s;
+    });
   return it;
 }
 
 template <class T, class P>
-T & cube<T,P>::operator()(size_t i, size_t j, size_t k)
+typename cube<T,P>::reference cube<T,P>::operator()(size_t i, size_t j, size_t k)
 {
 #ifndef NDEBUG
   assert(i<size_x());
@@ -277,7 +523,7 @@ T & cube<T,P>::operator()(size_t i, size_t j, size_t k)
 }
 
 template <class T, class P>
-T cube<T,P>::operator()(size_t i, size_t j, size_t k) const
+typename cube<T,P>::const_reference cube<T,P>::operator()(size_t i, size_t j, size_t k) const
 {
 #ifndef NDEBUG
   assert(i<size_x());
@@ -288,7 +534,7 @@ T cube<T,P>::operator()(size_t i, size_t j, size_t k) const
 }
 
 template <class T, class P>
-T & cube<T,P>::operator()(const cube_index & idx)
+typename cube<T,P>::reference cube<T,P>::operator()(const cube_index & idx)
 {
 #ifndef NDEBUG
   assert(idx < sizes_);
@@ -297,7 +543,7 @@ T & cube<T,P>::operator()(const cube_index & idx)
 }
 
 template <class T, class P>
-T cube<T,P>::operator()(const cube_index & idx) const
+typename cube<T,P>::const_reference cube<T,P>::operator()(const cube_index & idx) const
 {
 #ifndef NDEBUG
   assert(idx < sizes_);
@@ -308,13 +554,13 @@ T cube<T,P>::operator()(const cube_index & idx) const
 template <class T, class P>
 size_t cube<T,P>::index(size_t i, size_t j, size_t k) const
 {
-  return i + size_x() * (j + k * size_y());
+  return layout_type::index(i, j, k, sizes_);
 }
 
 template <class T, class P>
 size_t cube<T,P>::index(const cube_index & i) const
 {
-  return i.get<0>() + size<0>() * (i.get<1>() + i.get<2>() * size<1>());
+  return layout_type::index(i.get<0>(), i.get<1>(), i.get<2>(), sizes_);
 }
 
 template <class T, class P>
@@ -76,6 +76,11 @@ public:
 
   size_t volume() const { return index_[0] * index_[1] * index_[2]; }
 
+  // Index of linear position p in a row-major space with nx columns and ny rows
+  static cube_index from_linear(size_t p, size_t nx, size_t ny) {
+    return {p % nx, (p / nx) % ny, p / (nx * ny)};
+  }
+
   cube_index bound_lower(const cube_index & b) const;
   cube_index bound_upper(const cube_index & b) const;
   cube_index bound_upper_unique(const cube_index & b) const;
@@ -121,6 +126,128 @@ inline cube_index cube_index::bound_upper_unique(const cube_index & b) const
   };
 }
 
+// Periodic images crossed on every axis to reach a neighbour cell.
+// Adding the shift times the cube size on each axis to the neighbour
+// coordinates gives its minimum image with respect to the visited cell.
+class cube_shift {
+
+  template <int I,typename RT>
+  using requires_dim = typename std::enable_if<I>=0 && I<3,RT>::type;
+
+public:
+  constexpr cube_shift(int i, int j, int k) : shift_{i,j,k} {}
+
+  template <int I>
+  requires_dim<I,int> get() const { return shift_[I]; }
+
+  bool is_zero() const { return shift_[0]==0 && shift_[1]==0 && shift_[2]==0; }
+
+  bool operator==(const cube_shift & s) const { return std::equal(shift_, shift_+3, s.shift_); }
+  bool operator!=(const cube_shift & s) const { return !(*this == s); }
+
+  friend std::ostream & operator<<(std::ostream & o, const cube_shift & s) {
+    return o << "( " << s.shift_[0] << " , " << s.shift_[1] << " , " << s.shift_[2] << " )";
+  }
+
+private:
+  int shift_[3];
+};
+
+// Offset of a neighbour cell on every axis
+struct neighbour_offset {
+  int dx, dy, dz;
+};
+
+// The 26 neighbour offsets, in the order of cube::for_all_neighbours
+constexpr neighbour_offset neighbour_shell[26] = {
+  {-1,-1,-1}, {0,-1,-1}, {1,-1,-1}, {-1,0,-1}, {0,0,-1}, {1,0,-1}, {-1,1,-1}, {0,1,-1}, {1,1,-1},
+  {-1,-1,0}, {0,-1,0}, {1,-1,0}, {-1,0,0}, {1,0,0}, {-1,1,0}, {0,1,0}, {1,1,0},
+  {-1,-1,1}, {0,-1,1}, {1,-1,1}, {-1,0,1}, {0,0,1}, {1,0,1}, {-1,1,1}, {0,1,1}, {1,1,1}
+};
+
+// The 13 half-shell offsets, in the order of cube::for_all_neighbours_unique.
+// Exactly one of every pair of opposite offsets is included.
+constexpr neighbour_offset neighbour_half_shell[13] = {
+  {-1,-1,-1}, {-1,-1,0}, {-1,0,-1}, {-1,0,0}, {-1,1,-1},
+  {0,-1,-1}, {0,-1,0}, {0,0,-1}, {0,1,-1},
+  {1,-1,-1}, {1,-1,0}, {1,0,-1}, {1,1,-1}
+};
+
+// Linear offset of a neighbour in a row-major space with strides sy and sz
+constexpr std::ptrdiff_t linear_offset(neighbour_offset o, std::ptrdiff_t sy, std::ptrdiff_t sz)
+{
+  return o.dx + o.dy * sy + o.dz * sz;
+}
+
+// Calls f(p, i) for every linear position p in [first,last) of a row-major
+// space with nx columns and ny rows, where i is the cube_index of p.
+template <class F>
+void for_each_index(size_t first, size_t last, size_t nx, size_t ny, F f)
+{
+  if (first==last) return;
+  const cube_index start = cube_index::from_linear(first, nx, ny);
+  size_t i = start.get<0>();
+  size_t j = start.get<1>();
+  size_t k = start.get<2>();
+  for (auto p=first; p!=last; ++p) {
+    f(p, cube_index{i,j,k});
+    if (++i == nx) {
+      i = 0;
+      if (++j == ny) {
+        j = 0;
+        ++k;
+      }
+    }
+  }
+}
+
+// Axis-aligned box of cells [lower,upper) of a cube, swept as runs of
+// consecutive x. visit calls f(p, i) for every cell of the runs
+// [first,last), where p is the row-major position of cell i in a cube of
+// sizes n.
+class cube_region {
+public:
+  cube_region(const cube_index & lo, const cube_index & hi) : lower_{lo}, upper_{hi} {}
+
+  const cube_index & lower() const { return lower_; }
+  const cube_index & upper() const { return upper_; }
+
+  size_t length() const { return upper_.get<0>() - lower_.get<0>(); }
+  size_t runs() const { return (length()==0) ? 0 :
+      (upper_.get<1>() - lower_.get<1>()) * (upper_.get<2>() - lower_.get<2>()); }
+  size_t volume() const { return length() * runs(); }
+
+  template <class F>
+  void visit(F f, const cube_index & n, size_t first, size_t last) const;
+
+  // Visits the cells of run r with x in [first,last)
+  template <class F>
+  void visit_run(F f, const cube_index & n, size_t r, size_t first, size_t last) const;
+
+private:
+  cube_index lower_;
+  cube_index upper_;
+};
+
+template <class F>
+void cube_region::visit(F f, const cube_index & n, size_t first, size_t last) const
+{
+  for (auto r=first; r!=last; ++r) {
+    visit_run(f, n, r, lower_.get<0>(), upper_.get<0>());
+  }
+}
+
+template <class F>
+void cube_region::visit_run(F f, const cube_index & n, size_t r, size_t first, size_t last) const
+{
+  const size_t ny = upper_.get<1>() - lower_.get<1>();
+  const size_t y = lower_.get<1>() + r % ny;
+  const size_t z = lower_.get<2>() + r / ny;
+  const size_t base = n.get<0>() * (z * n.get<1>() + y);
+  for (size_t x=first; x!=last; ++x) {
+    f(base + x, cube_index{x,y,z});
+  }
+}
 
 }
 
@@ -23,7 +23,11 @@ SOFTWARE.
 #define YAPL_CUBE_MAPPING_H
 
 #include "cube_index.h"
+#include "layout.h"
+#include "reduction.h"
 #include <memory>
+#include <type_traits>
+#include <utility>
 
 namespace yapl {
 
@@ -37,6 +41,62 @@ protected:
   S * pstruc_;
 };
 
+// Calls f ignoring the cube_index passed with the element
+template <class F>
+struct ignore_index {
+  F f;
+
+  template <class X>
+  auto operator()(X && x, const cube_index &) const -> decltype(f(std::forward<X>(x))) {
+    return f(std::forward<X>(x));
+  }
+};
+
+// Flat sweeps over all the cells of a cube stored in S.
+// Padded layouts (see layout.h) run them as indexed sweeps, which only
+// visit positions holding cells.
+template <class S, bool Padded = S::layout_type::padded>
+struct cube_cells {
+  template <class B, class F>
+  static void apply(B * b, F f, const cube_index & n) { b->apply(f, n.volume()); }
+
+  template <class B, class V, class R, class F, class M>
+  static V transform_reduce(B * b, V init, R r, F f, const cube_index & n, M mode) {
+    return b->transform_reduce(init, r, f, n.volume(), mode);
+  }
+};
+
+template <class S>
+struct cube_cells<S,true> {
+  template <class B, class F>
+  static void apply(B * b, F f, const cube_index & n) { b->apply(ignore_index<F>{f}, n); }
+
+  template <class B, class V, class R, class F, class M>
+  static V transform_reduce(B * b, V init, R r, F f, const cube_index & n, M mode) {
+    return b->transform_reduce(init, r, ignore_index<F>{f}, n, mode);
+  }
+};
+
+// Ordered flat sweeps follow cube_index order, so only row-major storage
+// runs them over the storage range. Other layouts run indexed sweeps.
+template <class S, bool RowMajor = std::is_same<typename S::layout_type, row_major_layout>::value>
+struct ordered_cube_cells {
+  template <class B, class F>
+  static void apply_ordered(B * b, F f, const cube_index & n) { b->apply_ordered(f, n.volume()); }
+
+  template <class B, class F, class C>
+  static void apply_ordered(B * b, F f, C c, const cube_index & n) { b->apply_ordered(f, c, n.volume()); }
+};
+
+template <class S>
+struct ordered_cube_cells<S,false> {
+  template <class B, class F>
+  static void apply_ordered(B * b, F f, const cube_index & n) { b->apply_ordered(ignore_index<F>{f}, n); }
+
+  template <class B, class F, class C>
+  static void apply_ordered(B * b, F f, C c, const cube_index & n) { b->apply_ordered(ignore_index<F>{f}, c, n); }
+};
+
 template <class S>
 class full_cube_mapping : public cube_mapping_base<S> {
 public:
@@ -51,6 +111,15 @@ public:
   template <class F>
   void apply_indexed(F f);
 
+  template <class V, class R, class M = unordered_reduction>
+  V reduce(V init, R r, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce(V init, R r, F f, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce_indexed(V init, R r, F f, M mode = M{});
+
 protected:
   using cube_mapping_base<S>::pstruc_;
   using cube_mapping_base<S>::sizes_;
@@ -60,7 +129,7 @@ template <class S>
 template <class F>
 void full_cube_mapping<S>::apply(F f)
 {
-  pstruc_->apply(f, sizes_.volume());
+  cube_cells<S>::apply(pstruc_, f, sizes_);
 }
 
 template <class S>
@@ -70,6 +139,29 @@ void full_cube_mapping<S>::apply_indexed(F f)
   pstruc_->apply(f, sizes_);
 }
 
+template <class S>
+template <class V, class R, class M>
+V full_cube_mapping<S>::reduce(V init, R r, M mode)
+{
+  return cube_cells<S>::transform_reduce(pstruc_, init, r, identity_transform{}, sizes_, mode);
+}
+
+template <class S>
+template <class V, class R, class F, class M>
+V full_cube_mapping<S>::transform_reduce(V init, R r, F f, M mode)
+{
+  return cube_cells<S>::transform_reduce(pstruc_, init, r, f, sizes_, mode);
+}
+
+template <class S>
+template <class V, class R, class F, class M>
+V full_cube_mapping<S>::transform_reduce_indexed(V init, R r, F f, M mode)
+{
+  return pstruc_->transform_reduce(init, r, f, sizes_, mode);
+}
+
+// Mapping whose sweeps visit the cells in cube_index order (x fastest, then
+// y, then z), whatever the storage layout of the structure.
 template <class S>
 class full_cube_ordered_mapping : public full_cube_mapping<S> {
 public:
@@ -84,6 +176,13 @@ public:
   template <class F>
   void apply_indexed(F f);
 
+  // Runs f in parallel and passes its results to c in element order
+  template <class F, class C>
+  void apply(F f, C c);
+
+  template <class F, class C>
+  void apply_indexed(F f, C c);
+
 protected:
   using full_cube_mapping<S>::pstruc_;
   using full_cube_mapping<S>::sizes_;
@@ -93,7 +192,7 @@ template <class S>
 template <class F>
 void full_cube_ordered_mapping<S>::apply(F f)
 {
-  pstruc_->apply_ordered(f, sizes_.volume());
+  ordered_cube_cells<S>::apply_ordered(pstruc_, f, sizes_);
 }
 
 template <class S>
@@ -103,6 +202,20 @@ void full_cube_ordered_mapping<S>::apply_indexed(F f)
   pstruc_->apply_ordered(f, sizes_);
 }
 
+template <class S>
+template <class F, class C>
+void full_cube_ordered_mapping<S>::apply(F f, C c)
+{
+  ordered_cube_cells<S>::apply_ordered(pstruc_, f, c, sizes_);
+}
+
+template <class S>
+template <class F, class C>
+void full_cube_ordered_mapping<S>::apply_indexed(F f, C c)
+{
+  pstruc_->apply_ordered(f, c, sizes_);
+}
+
 
 template <class S>
 class const_cube_mapping_base {
@@ -128,6 +241,15 @@ public:
   template <class F>
   void apply_indexed(F f);
 
+  template <class V, class R, class M = unordered_reduction>
+  V reduce(V init, R r, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce(V init, R r, F f, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce_indexed(V init, R r, F f, M mode = M{});
+
 protected:
   using const_cube_mapping_base<S>::pstruc_;
   using const_cube_mapping_base<S>::sizes_;
@@ -137,7 +259,7 @@ template <class S>
 template <class F>
 void const_full_cube_mapping<S>::apply(F f)
 {
-  pstruc_->apply(f, sizes_.volume());
+  cube_cells<S>::apply(pstruc_, f, sizes_);
 }
 
 template <class S>
@@ -147,17 +269,62 @@ void const_full_cube_mapping<S>::apply_indexed(F f)
   pstruc_->apply(f, sizes_);
 }
 
+template <class S>
+template <class V, class R, class M>
+V const_full_cube_mapping<S>::reduce(V init, R r, M mode)
+{
+  return cube_cells<S>::transform_reduce(pstruc_, init, r, identity_transform{}, sizes_, mode);
+}
+
+template <class S>
+template <class V, class R, class F, class M>
+V const_full_cube_mapping<S>::transform_reduce(V init, R r, F f, M mode)
+{
+  return cube_cells<S>::transform_reduce(pstruc_, init, r, f, sizes_, mode);
+}
+
+template <class S>
+template <class V, class R, class F, class M>
+V const_full_cube_mapping<S>::transform_reduce_indexed(V init, R r, F f, M mode)
+{
+  return pstruc_->transform_reduce(init, r, f, sizes_, mode);
+}
+
 template <class S, int I>
 class plane_cube_mapping : public cube_mapping_base<S> {
 public:
   plane_cube_mapping(S * ps, size_t i, size_t nx, size_t ny, size_t nz) :
     cube_mapping_base<S>{ps,nx,ny,nz}, index_{i} {}
   plane_cube_mapping(S * ps, size_t i, const cube_index & sz) :
-    cube_mapping_base<S>{ps,sz} {}
+    cube_mapping_base<S>{ps,sz}, index_{i} {}
 
   template <class F>
   void apply(F f);
 
+  template <class F>
+  void apply_indexed(F f);
+
+  // Copies the plane to or from a contiguous buffer of size() cells, so that
+  // strided planes can be processed with unit stride. Cells are ordered by
+  // the first remaining axis, then by the second.
+  template <class T>
+  void gather(T * out) const;
+
+  template <class T>
+  void scatter(const T * in);
+
+  // Number of cells in the plane
+  size_t size() const;
+
+  template <class V, class R, class M = unordered_reduction>
+  V reduce(V init, R r, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce(V init, R r, F f, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce_indexed(V init, R r, F f, M mode = M{});
+
 protected:
   size_t index_;
   using cube_mapping_base<S>::pstruc_;
@@ -171,6 +338,184 @@ void plane_cube_mapping<S,I>::apply(F f)
   pstruc_->template apply_plane<F,I>(f, index_, sizes_);
 }
 
+template <class S, int I>
+template <class F>
+void plane_cube_mapping<S,I>::apply_indexed(F f)
+{
+  pstruc_->template apply_plane_indexed<I>(f, index_, sizes_);
+}
+
+template <class S, int I>
+template <class T>
+void plane_cube_mapping<S,I>::gather(T * out) const
+{
+  pstruc_->template gather_plane<I>(out, index_, sizes_);
+}
+
+template <class S, int I>
+template <class T>
+void plane_cube_mapping<S,I>::scatter(const T * in)
+{
+  pstruc_->template scatter_plane<I>(in, index_, sizes_);
+}
+
+template <class S, int I>
+size_t plane_cube_mapping<S,I>::size() const
+{
+  const size_t nx = sizes_.template get<0>();
+  const size_t ny = sizes_.template get<1>();
+  const size_t nz = sizes_.template get<2>();
+  return (I==0) ? ny * nz : (I==1) ? nx * nz : nx * ny;
+}
+
+template <class S, int I>
+template <class V, class R, class M>
+V plane_cube_mapping<S,I>::reduce(V init, R r, M mode)
+{
+  return pstruc_->template transform_reduce_plane<I>(init, r, identity_transform{}, index_, sizes_, mode);
+}
+
+template <class S, int I>
+template <class V, class R, class F, class M>
+V plane_cube_mapping<S,I>::transform_reduce(V init, R r, F f, M mode)
+{
+  return pstruc_->template transform_reduce_plane<I>(init, r, f, index_, sizes_, mode);
+}
+
+template <class S, int I>
+template <class V, class R, class F, class M>
+V plane_cube_mapping<S,I>::transform_reduce_indexed(V init, R r, F f, M mode)
+{
+  return pstruc_->template transform_reduce_plane_indexed<I>(init, r, f, index_, sizes_, mode);
+}
+
+// Mapping over the box of cells [lower,upper) of a cube
+template <class S>
+class region_cube_mapping : public cube_mapping_base<S> {
+public:
+  region_cube_mapping(S * ps, const cube_index & sz, const cube_region & g) :
+    cube_mapping_base<S>{ps,sz}, region_{g} {}
+
+  template <class F>
+  void apply(F f);
+
+  template <class F>
+  void apply_indexed(F f);
+
+  template <class V, class R, class M = unordered_reduction>
+  V reduce(V init, R r, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce(V init, R r, F f, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce_indexed(V init, R r, F f, M mode = M{});
+
+protected:
+  cube_region region_;
+  using cube_mapping_base<S>::pstruc_;
+  using cube_mapping_base<S>::sizes_;
+};
+
+template <class S>
+template <class F>
+void region_cube_mapping<S>::apply(F f)
+{
+  pstruc_->apply_region(ignore_index<F>{f}, region_, sizes_);
+}
+
+template <class S>
+template <class F>
+void region_cube_mapping<S>::apply_indexed(F f)
+{
+  pstruc_->apply_region(f, region_, sizes_);
+}
+
+template <class S>
+template <class V, class R, class M>
+V region_cube_mapping<S>::reduce(V init, R r, M mode)
+{
+  return pstruc_->transform_reduce_region(init, r, ignore_index<identity_transform>{identity_transform{}}, region_, sizes_, mode);
+}
+
+template <class S>
+template <class V, class R, class F, class M>
+V region_cube_mapping<S>::transform_reduce(V init, R r, F f, M mode)
+{
+  return pstruc_->transform_reduce_region(init, r, ignore_index<F>{f}, region_, sizes_, mode);
+}
+
+template <class S>
+template <class V, class R, class F, class M>
+V region_cube_mapping<S>::transform_reduce_indexed(V init, R r, F f, M mode)
+{
+  return pstruc_->transform_reduce_region(init, r, f, region_, sizes_, mode);
+}
+
+template <class S>
+class const_region_cube_mapping : public const_cube_mapping_base<S> {
+public:
+  const_region_cube_mapping(const S * ps, const cube_index & sz, const cube_region & g) :
+    const_cube_mapping_base<S>{ps,sz}, region_{g} {}
+
+  template <class F>
+  void apply(F f);
+
+  template <class F>
+  void apply_indexed(F f);
+
+  template <class V, class R, class M = unordered_reduction>
+  V reduce(V init, R r, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce(V init, R r, F f, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce_indexed(V init, R r, F f, M mode = M{});
+
+protected:
+  cube_region region_;
+  using const_cube_mapping_base<S>::pstruc_;
+  using const_cube_mapping_base<S>::sizes_;
+};
+
+template <class S>
+template <class F>
+void const_region_cube_mapping<S>::apply(F f)
+{
+  pstruc_->apply_region(ignore_index<F>{f}, region_, sizes_);
+}
+
+template <class S>
+template <class F>
+void const_region_cube_mapping<S>::apply_indexed(F f)
+{
+  pstruc_->apply_region(f, region_, sizes_);
+}
+
+template <class S>
+template <class V, class R, class M>
+V const_region_cube_mapping<S>::reduce(V init, R r, M mode)
+{
+  return pstruc_->transform_reduce_region(init, r, ignore_index<identity_transform>{identity_transform{}}, region_, sizes_, mode);
+}
+
+template <class S>
+template <class V, class R, class F, class M>
+V const_region_cube_mapping<S>::transform_reduce(V init, R r, F f, M mode)
+{
+  return pstruc_->transform_reduce_region(init, r, ignore_index<F>{f}, region_, sizes_, mode);
+}
+
+template <class S>
+template <class V, class R, class F, class M>
+V const_region_cube_mapping<S>::transform_reduce_indexed(V init, R r, F f, M mode)
+{
+  return pstruc_->transform_reduce_region(init, r, f, region_, sizes_, mode);
+}
+
+// Read-only counterpart of full_cube_ordered_mapping, visiting the cells in
+// cube_index order as well
 template <class S>
 class const_full_cube_ordered_mapping : public const_full_cube_mapping<S> {
 public:
@@ -185,6 +530,13 @@ public:
   template <class F>
   void apply_indexed(F f);
 
+  // Runs f in parallel and passes its results to c in element order
+  template <class F, class C>
+  void apply(F f, C c);
+
+  template <class F, class C>
+  void apply_indexed(F f, C c);
+
 protected:
   using const_full_cube_mapping<S>::pstruc_;
   using const_full_cube_mapping<S>::sizes_;
@@ -194,7 +546,7 @@ template <class S>
 template <class F>
 void const_full_cube_ordered_mapping<S>::apply(F f)
 {
-  pstruc_->apply_ordered(f, sizes_.volume());
+  ordered_cube_cells<S>::apply_ordered(pstruc_, f, sizes_);
 }
 
 template <class S>
@@ -204,6 +556,20 @@ void const_full_cube_ordered_mapping<S>::apply_indexed(F f)
   pstruc_->apply_ordered(f, sizes_);
 }
 
+template <class S>
+template <class F, class C>
+void const_full_cube_ordered_mapping<S>::apply(F f, C c)
+{
+  ordered_cube_cells<S>::apply_ordered(pstruc_, f, c, sizes_);
+}
+
+template <class S>
+template <class F, class C>
+void const_full_cube_ordered_mapping<S>::apply_indexed(F f, C c)
+{
+  pstruc_->apply_ordered(f, c, sizes_);
+}
+
 
 }
 
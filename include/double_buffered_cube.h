@@ -0,0 +1,229 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_DOUBLE_BUFFERED_CUBE_H
+#define YAPL_DOUBLE_BUFFERED_CUBE_H
+
+#include "allocation.h"
+#include "cube.h"
+#include "cube_index.h"
+#include <cstddef>
+#include <memory>
+
+#ifndef NDEBUG
+#include <cassert>
+#endif
+
+namespace yapl {
+
+// Read-only view of the cells around a cell of a cube.
+// Offsets wrap around periodic axes of the cube. On other axes the
+// neighbour must lie inside the cube.
+template <class C>
+class cube_neighbourhood {
+public:
+  using const_reference = typename C::const_reference;
+
+  cube_neighbourhood(const C & c, const cube_index & i) : cube_{c}, index_{i} {}
+
+  const cube_index & index() const { return index_; }
+
+  const_reference centre() const { return cube_(index_); }
+  const_reference operator()(int dx, int dy, int dz) const;
+
+  // True if the neighbour at the offset exists
+  bool contains(int dx, int dy, int dz) const;
+
+private:
+  template <int I>
+  bool coordinate(int d, size_t & x) const;
+
+private:
+  const C & cube_;
+  cube_index index_;
+};
+
+template <class C>
+template <int I>
+bool cube_neighbourhood<C>::coordinate(int d, size_t & x) const
+{
+  const std::ptrdiff_t n = cube_.template size<I>();
+  std::ptrdiff_t y = static_cast<std::ptrdiff_t>(index_.get<I>()) + d;
+  if (cube_.template periodic<I>()) {
+    y %= n;
+    if (y<0) y += n;
+  }
+  else if (y<0 || y>=n) {
+    return false;
+  }
+  x = y;
+  return true;
+}
+
+template <class C>
+typename cube_neighbourhood<C>::const_reference cube_neighbourhood<C>::operator()(int dx, int dy, int dz) const
+{
+  size_t x = 0, y = 0, z = 0;
+  const bool found = coordinate<0>(dx,x) & coordinate<1>(dy,y) & coordinate<2>(dz,z);
+#ifndef NDEBUG
+  assert(found);
+#else
+  (void) found;
+#endif
+  return cube_(x,y,z);
+}
+
+template <class C>
+bool cube_neighbourhood<C>::contains(int dx, int dy, int dz) const
+{
+  size_t x, y, z;
+  return coordinate<0>(dx,x) && coordinate<1>(dy,y) && coordinate<2>(dz,z);
+}
+
+// Pair of cubes for time-stepped stencils.
+// Each step reads the previous state and writes the next one, so a kernel
+// cannot read cells updated in the same step. Buffers are flipped in
+// constant time at the end of every step.
+template <class T, class P>
+class double_buffered_cube {
+  // Both buffers are built from the same allocation arguments
+  static_assert(!is_shared_allocation<typename P::allocation_type>::value,
+      "double buffered cubes need an allocation that gives each buffer its own storage");
+
+public:
+  using cube_type = cube<T,P>;
+  using neighbourhood_type = cube_neighbourhood<cube_type>;
+
+  template <int I,typename RT>
+  using requires_dim = typename cube_type::template requires_dim<I,RT>;
+
+public:
+  double_buffered_cube() = delete;
+
+  double_buffered_cube(size_t nx, size_t ny, size_t nz);
+  double_buffered_cube(const cube_index & i);
+
+  // Both buffers are built with the extra arguments of the cube constructor
+  template <class ... A>
+  double_buffered_cube(size_t nx, size_t ny, size_t nz, const A & ... a);
+
+  template <class ... A>
+  double_buffered_cube(const cube_index & i, const A & ... a);
+
+  double_buffered_cube(const double_buffered_cube &) = delete;
+  double_buffered_cube & operator=(const double_buffered_cube &) = delete;
+
+  double_buffered_cube(double_buffered_cube &&) = delete;
+  double_buffered_cube & operator=(double_buffered_cube &&) = delete;
+
+  size_t size_x() const { return current().size_x(); }
+  size_t size_y() const { return current().size_y(); }
+  size_t size_z() const { return current().size_z(); }
+
+  template <int I>
+  requires_dim<I,size_t> size() const { return current().template size<I>(); }
+
+  // Periodic axes wrap neighbourhood offsets around the cube
+  void set_periodic(bool x, bool y, bool z);
+
+  // State after the last step. Writes are meant for initial and
+  // boundary values.
+  cube_type & current() { return *buffers_[current_]; }
+  const cube_type & current() const { return *buffers_[current_]; }
+
+  // State before the last step
+  const cube_type & previous() const { return *buffers_[1-current_]; }
+
+  // Number of steps run so far
+  size_t steps() const { return steps_; }
+
+  // Runs a step: calls f(x, n) in parallel for every cell x of the next
+  // state, where n is the neighbourhood of the cell in the current state.
+  // The next state becomes current afterwards.
+  template <class F>
+  void apply_stencil(F f);
+
+  // Exchanges the current and previous states
+  void flip() { current_ = 1 - current_; }
+
+private:
+  std::unique_ptr<cube_type> buffers_[2];
+  int current_;
+  size_t steps_;
+};
+
+template <class T, class P>
+double_buffered_cube<T,P>::double_buffered_cube(size_t nx, size_t ny, size_t nz)
+:
+buffers_{std::unique_ptr<cube_type>{new cube_type{nx,ny,nz}}, std::unique_ptr<cube_type>{new cube_type{nx,ny,nz}}},
+current_{0},
+steps_{0}
+{
+}
+
+template <class T, class P>
+double_buffered_cube<T,P>::double_buffered_cube(const cube_index & i)
+:
+double_buffered_cube{i.get<0>(), i.get<1>(), i.get<2>()}
+{
+}
+
+template <class T, class P>
+template <class ... A>
+double_buffered_cube<T,P>::double_buffered_cube(size_t nx, size_t ny, size_t nz, const A & ... a)
+:
+buffers_{std::unique_ptr<cube_type>{new cube_type{nx,ny,nz,a...}}, std::unique_ptr<cube_type>{new cube_type{nx,ny,nz,a...}}},
+current_{0},
+steps_{0}
+{
+}
+
+template <class T, class P>
+template <class ... A>
+double_buffered_cube<T,P>::double_buffered_cube(const cube_index & i, const A & ... a)
+:
+double_buffered_cube{i.get<0>(), i.get<1>(), i.get<2>(), a...}
+{
+}
+
+template <class T, class P>
+void double_buffered_cube<T,P>::set_periodic(bool x, bool y, bool z)
+{
+  buffers_[0]->set_periodic(x,y,z);
+  buffers_[1]->set_periodic(x,y,z);
+}
+
+template <class T, class P>
+template <class F>
+void double_buffered_cube<T,P>::apply_stencil(F f)
+{
+  const cube_type & in = *buffers_[current_];
+  cube_type & out = *buffers_[1-current_];
+  out.all().apply_indexed([f,&in](typename cube_type::reference x, const cube_index & i) {
+    f(x, neighbourhood_type{in, i});
+  });
+  flip();
+  ++steps_;
+}
+
+}
+
+#endif
@@ -0,0 +1,464 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_HALO_CUBE_H
+#define YAPL_HALO_CUBE_H
+
+#include "cube_index.h"
+#include "block.h"
+#include "boundary.h"
+#include "layout.h"
+#include "reduction.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#ifndef NDEBUG
+#include <cassert>
+#endif
+
+namespace yapl {
+
+template <class C> class halo_interior_mapping;
+
+// Cube surrounded by H layers of halo cells.
+// Every cell in the cube has its 26 neighbours in storage, so neighbour
+// traversal uses fixed offsets without bound checks. Halo cells are set by a
+// boundary policy (see boundary.h) through fill_halo(), which must be called
+// again whenever the cells they copy change.
+// Unlike cube, neighbour functions visit halo cells on the cube faces.
+template <class T, class P, size_t H = 1>
+class halo_cube {
+public:
+  static_assert(H > 0, "halo width must be at least one cell");
+  static_assert(std::is_same<typename P::layout_type, row_major_layout>::value,
+      "halo cubes are stored in row-major order");
+
+  static constexpr size_t halo = H;
+
+  using value_type = T;
+  using reference = T &;
+  using const_reference = const T &;
+
+public:
+  halo_cube() = delete;
+
+  halo_cube(size_t nx, size_t ny, size_t nz);
+  halo_cube(const cube_index & i);
+
+  // Extra arguments are passed to the block constructor
+  template <class ... A>
+  halo_cube(size_t nx, size_t ny, size_t nz, A && ... a);
+
+  template <class ... A>
+  halo_cube(const cube_index & i, A && ... a);
+
+  halo_cube(const halo_cube &) = delete;
+  halo_cube & operator=(const halo_cube &) = delete;
+
+  halo_cube(halo_cube &&) = delete;
+  halo_cube & operator=(halo_cube &&) = delete;
+
+  size_t size_x() const { return sizes_.get<0>(); }
+  size_t size_y() const { return sizes_.get<1>(); }
+  size_t size_z() const { return sizes_.get<2>(); }
+
+  cube_index size() const { return sizes_; }
+
+  // Sizes including halo cells
+  cube_index padded_size() const { return padded_; }
+
+  // Cells of the cube, excluding halo cells
+  halo_interior_mapping<halo_cube> interior() { return {this}; }
+  halo_interior_mapping<const halo_cube> interior() const { return {this}; }
+
+  // Sets every halo cell from boundary policy b
+  template <class B>
+  void fill_halo(const B & b);
+
+  template <typename F>
+  void for_all_neighbours(size_t i, size_t j, size_t k, F f);
+
+  template <typename F>
+  void for_all_neighbours(const cube_index & i, F f);
+
+  template <typename F>
+  void for_all_neighbours_unique(size_t i, size_t j, size_t k, F f);
+
+  template <typename F>
+  void for_all_neighbours_unique(const cube_index & i, F f);
+
+  T ** fill_neighbours_unique(size_t i, size_t j, size_t k, T ** it);
+
+  T ** fill_neighbours_unique(const cube_index & i, T ** it);
+
+  T & operator()(size_t i, size_t j, size_t k);
+  const T & operator()(size_t i, size_t j, size_t k) const;
+
+  T & operator()(const cube_index & i);
+  const T & operator()(const cube_index & i) const;
+
+  // Cell at coordinates in [-H,n+H) on every axis, halo cells included
+  T & at(std::ptrdiff_t i, std::ptrdiff_t j, std::ptrdiff_t k);
+  const T & at(std::ptrdiff_t i, std::ptrdiff_t j, std::ptrdiff_t k) const;
+
+private:
+  friend class halo_interior_mapping<halo_cube>;
+  friend class halo_interior_mapping<const halo_cube>;
+
+  size_t index(std::ptrdiff_t i, std::ptrdiff_t j, std::ptrdiff_t k) const;
+
+  void init_offsets();
+
+  // Calls f(row, j, k) for every row (j,k) of nx cells in the cube
+  template <class F>
+  void apply_rows(F f) const;
+
+  template <class V, class R, class F, class M>
+  V transform_reduce_rows(V init, R r, F f, M mode) const;
+
+private:
+  using partitioner_type = typename P::partitioner_type;
+
+  cube_index sizes_;
+  cube_index padded_;
+  block<T,P> grid_;
+  std::unique_ptr<partitioner_type> part_;
+  // Neighbour offsets, in the same order as cube
+  std::ptrdiff_t all_offsets_[26];
+  std::ptrdiff_t unique_offsets_[13];
+};
+
+template <class T, class P, size_t H>
+constexpr size_t halo_cube<T,P,H>::halo;
+
+// Mapping over the cells of a halo_cube, excluding halo cells
+template <class C>
+class halo_interior_mapping {
+public:
+  halo_interior_mapping(C * c) : pcube_{c} {}
+
+  template <class F>
+  void apply(F f);
+
+  template <class F>
+  void apply_indexed(F f);
+
+  template <class V, class R, class M = unordered_reduction>
+  V reduce(V init, R r, M mode = M{});
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce(V init, R r, F f, M mode = M{});
+
+private:
+  using value_type = typename C::value_type;
+
+  C * pcube_;
+};
+
+template <class T, class P, size_t H>
+halo_cube<T,P,H>::halo_cube(size_t nx, size_t ny, size_t nz)
+:
+sizes_{nx,ny,nz},
+padded_{nx+2*H, ny+2*H, nz+2*H},
+grid_{padded_.volume()},
+part_{new partitioner_type{}}
+{
+  init_offsets();
+}
+
+template <class T, class P, size_t H>
+halo_cube<T,P,H>::halo_cube(const cube_index & i)
+:
+halo_cube{i.get<0>(), i.get<1>(), i.get<2>()}
+{
+}
+
+template <class T, class P, size_t H>
+template <class ... A>
+halo_cube<T,P,H>::halo_cube(size_t nx, size_t ny, size_t nz, A && ... a)
+:
+sizes_{nx,ny,nz},
+padded_{nx+2*H, ny+2*H, nz+2*H},
+grid_{padded_.volume(), std::forward<A>(a)...},
+part_{new partitioner_type{}}
+{
+  init_offsets();
+}
+
+template <class T, class P, size_t H>
+template <class ... A>
+halo_cube<T,P,H>::halo_cube(const cube_index & i, A && ... a)
+:
+halo_cube{i.get<0>(), i.get<1>(), i.get<2>(), std::forward<A>(a)...}
+{
+}
+
+template <class T, class P, size_t H>
+void halo_cube<T,P,H>::init_offsets()
+{
+  const std::ptrdiff_t sy = padded_.get<0>();
+  const std::ptrdiff_t sz = padded_.get<0>() * padded_.get<1>();
+  std::transform(neighbour_shell, neighbour_shell + 26, all_offsets_,
+    [=](neighbour_offset o) { return linear_offset(o, sy, sz); });
+  std::transform(neighbour_half_shell, neighbour_half_shell + 13, unique_offsets_,
+    [=](neighbour_offset o) { return linear_offset(o, sy, sz); });
+}
+
+template <class T, class P, size_t H>
+size_t halo_cube<T,P,H>::index(std::ptrdiff_t i, std::ptrdiff_t j, std::ptrdiff_t k) const
+{
+  const std::ptrdiff_t h = H;
+  const std::ptrdiff_t px = padded_.get<0>();
+  const std::ptrdiff_t py = padded_.get<1>();
+  return (i + h) + px * ((j + h) + (k + h) * py);
+}
+
+// Halo planes in z are filled whole, other planes only on their rim.
+// Cells mapped by the boundary policy copy cells in the cube, which are
+// never written here, so planes are filled in parallel.
+template <class T, class P, size_t H>
+template <class B>
+void halo_cube<T,P,H>::fill_halo(const B & b)
+{
+  const std::ptrdiff_t h = H;
+  const std::ptrdiff_t nx = size_x();
+  const std::ptrdiff_t ny = size_y();
+  const std::ptrdiff_t nz = size_z();
+  if (nx==0 || ny==0 || nz==0) return;
+  T * m = grid_.data();
+  auto set = [this,m,&b,nx,ny,nz](std::ptrdiff_t i, std::ptrdiff_t j, std::ptrdiff_t k) {
+    std::ptrdiff_t si = i, sj = j, sk = k;
+    if (((si>=0 && si<nx) || b.map(si,nx)) &&
+        ((sj>=0 && sj<ny) || b.map(sj,ny)) &&
+        ((sk>=0 && sk<nz) || b.map(sk,nz))) {
+      m[index(i,j,k)] = m[index(si,sj,sk)];
+    }
+    else {
+      b.assign(m[index(i,j,k)]);
+    }
+  };
+  P::executor_type::apply_range([set,h,nx,ny,nz](size_t first, size_t last) {
+      for (std::ptrdiff_t k=std::ptrdiff_t(first)-h; k!=std::ptrdiff_t(last)-h; ++k) {
+        const bool zhalo = k<0 || k>=nz;
+        for (std::ptrdiff_t j=-h; j<ny+h; ++j) {
+          if (zhalo || j<0 || j>=ny) {
+            for (std::ptrdiff_t i=-h; i<nx+h; ++i) { set(i,j,k); }
+          }
+          else {
+            for (std::ptrdiff_t i=-h; i<0; ++i) { set(i,j,k); }
+            for (std::ptrdiff_t i=nx; i<nx+h; ++i) { set(i,j,k); }
+          }
+        }
+      }
+    },
+    padded_.get<2>(), 0, *part_
+  );
+}
+
+template <class T, class P, size_t H>
+template <typename F>
+void halo_cube<T,P,H>::for_all_neighbours(size_t i, size_t j, size_t k, F f)
+{
+  T * p = grid_.data() + index(i,j,k);
+  for (auto d : all_offsets_) {
+    f(p[d]);
+  }
+}
+
+template <class T, class P, size_t H>
+template <typename F>
+void halo_cube<T,P,H>::for_all_neighbours(const cube_index & i, F f)
+{
+  for_all_neighbours(i.get<0>(), i.get<1>(), i.get<2>(), f);
+}
+
+template <class T, class P, size_t H>
+template <typename F>
+void halo_cube<T,P,H>::for_all_neighbours_unique(size_t i, size_t j, size_t k, F f)
+{
+  T * p = grid_.data() + index(i,j,k);
+  for (auto d : unique_offsets_) {
+    f(p[d]);
+  }
+}
+
+template <class T, class P, size_t H>
+template <typename F>
+void halo_cube<T,P,H>::for_all_neighbours_unique(const cube_index & i, F f)
+{
+  for_all_neighbours_unique(i.get<0>(), i.get<1>(), i.get<2>(), f);
+}
+
+template <class T, class P, size_t H>
+T ** halo_cube<T,P,H>::fill_neighbours_unique(size_t i, size_t j, size_t k, T ** it)
+{
+  T * p = grid_.data() + index(i,j,k);
+  for (auto d : unique_offsets_) {
+    *it++ = p + d;
+  }
+  return it;
+}
+
+template <class T, class P, size_t H>
+T ** halo_cube<T,P,H>::fill_neighbours_unique(const cube_index & i, T ** it)
+{
+  return fill_neighbours_unique(i.get<0>(), i.get<1>(), i.get<2>(), it);
+}
+
+template <class T, class P, size_t H>
+T & halo_cube<T,P,H>::operator()(size_t i, size_t j, size_t k)
+{
+#ifndef NDEBUG
+  assert(i<size_x());
+  assert(j<size_y());
+  assert(k<size_z());
+#endif
+  return grid_[index(i,j,k)];
+}
+
+template <class T, class P, size_t H>
+const T & halo_cube<T,P,H>::operator()(size_t i, size_t j, size_t k) const
+{
+#ifndef NDEBUG
+  assert(i<size_x());
+  assert(j<size_y());
+  assert(k<size_z());
+#endif
+  return grid_[index(i,j,k)];
+}
+
+template <class T, class P, size_t H>
+T & halo_cube<T,P,H>::operator()(const cube_index & i)
+{
+  return (*this)(i.get<0>(), i.get<1>(), i.get<2>());
+}
+
+template <class T, class P, size_t H>
+const T & halo_cube<T,P,H>::operator()(const cube_index & i) const
+{
+  return (*this)(i.get<0>(), i.get<1>(), i.get<2>());
+}
+
+template <class T, class P, size_t H>
+T & halo_cube<T,P,H>::at(std::ptrdiff_t i, std::ptrdiff_t j, std::ptrdiff_t k)
+{
+  return grid_[index(i,j,k)];
+}
+
+template <class T, class P, size_t H>
+const T & halo_cube<T,P,H>::at(std::ptrdiff_t i, std::ptrdiff_t j, std::ptrdiff_t k) const
+{
+  return grid_[index(i,j,k)];
+}
+
+template <class T, class P, size_t H>
+template <class F>
+void halo_cube<T,P,H>::apply_rows(F f) const
+{
+  T * origin = const_cast<T*>(grid_.data()) + index(0,0,0);
+  const size_t ny = size_y();
+  const size_t sy = padded_.get<0>();
+  const size_t sz = padded_.get<0>() * padded_.get<1>();
+  P::executor_type::apply_range([f,origin,ny,sy,sz](size_t first, size_t last) {
+      for (auto r=first; r!=last; ++r) {
+        const size_t j = r % ny;
+        const size_t k = r / ny;
+        f(origin + j * sy + k * sz, j, k);
+      }
+    },
+    ny * size_z(), P::grain_size, *part_
+  );
+}
+
+// Reduces whole rows, so deterministic chunks are made of rows
+template <class T, class P, size_t H>
+template <class V, class R, class F, class M>
+V halo_cube<T,P,H>::transform_reduce_rows(V init, R r, F f, M mode) const
+{
+  T * origin = const_cast<T*>(grid_.data()) + index(0,0,0);
+  const size_t nx = size_x();
+  const size_t ny = size_y();
+  const size_t sy = padded_.get<0>();
+  const size_t sz = padded_.get<0>() * padded_.get<1>();
+  const size_t nrows = (nx==0) ? 0 : ny * size_z();
+  return P::executor_type::reduce_range(nrows, init, r,
+    [f,r,origin,nx,ny,sy,sz](size_t first, size_t last) -> V {
+      T * row = origin + (first % ny) * sy + (first / ny) * sz;
+      V acc = f(row[0]);
+      for (size_t i=1; i!=nx; ++i) {
+        acc = r(acc, f(row[i]));
+      }
+      for (auto q=first+1; q!=last; ++q) {
+        row = origin + (q % ny) * sy + (q / ny) * sz;
+        for (size_t i=0; i!=nx; ++i) {
+          acc = r(acc, f(row[i]));
+        }
+      }
+      return acc;
+    },
+    mode
+  );
+}
+
+template <class C>
+template <class F>
+void halo_interior_mapping<C>::apply(F f)
+{
+  const size_t nx = pcube_->size_x();
+  pcube_->apply_rows([f,nx](value_type * row, size_t, size_t) {
+    for (size_t i=0; i!=nx; ++i) {
+      f(row[i]);
+    }
+  });
+}
+
+template <class C>
+template <class F>
+void halo_interior_mapping<C>::apply_indexed(F f)
+{
+  const size_t nx = pcube_->size_x();
+  pcube_->apply_rows([f,nx](value_type * row, size_t j, size_t k) {
+    for (size_t i=0; i!=nx; ++i) {
+      f(row[i], cube_index{i,j,k});
+    }
+  });
+}
+
+template <class C>
+template <class V, class R, class M>
+V halo_interior_mapping<C>::reduce(V init, R r, M mode)
+{
+  return pcube_->transform_reduce_rows(init, r, identity_transform{}, mode);
+}
+
+template <class C>
+template <class V, class R, class F, class M>
+V halo_interior_mapping<C>::transform_reduce(V init, R r, F f, M mode)
+{
+  return pcube_->transform_reduce_rows(init, r, f, mode);
+}
+
+}
+
+#endif
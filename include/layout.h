@@ -0,0 +1,447 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_LAYOUT_H
+#define YAPL_LAYOUT_H
+
+#include "cube_index.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Storage layouts mapping cube cells to positions in a block.
+// A layout provides:
+//   size(n): Number of storage positions for a cube of sizes n.
+//   index(i,j,k,n): Storage position of cell (i,j,k).
+//   visit(f,n,first,last): Calls f(position, cube_index) for every cell
+//     stored in positions [first,last), in storage order.
+//   padded: Whether storage has positions not holding a cell. visit skips
+//     them, and flat sweeps over the cube go through visit.
+
+namespace yapl {
+
+// Cells stored in row-major order (x fastest, then y, then z)
+struct row_major_layout {
+  static constexpr bool padded = false;
+
+  static size_t size(const cube_index & n) { return n.volume(); }
+
+  static size_t index(size_t i, size_t j, size_t k, const cube_index & n) {
+    return i + n.get<0>() * (j + k * n.get<1>());
+  }
+
+  template <class F>
+  static void visit(F f, const cube_index & n, size_t first, size_t last) {
+    for_each_index(first, last, n.get<0>(), n.get<1>(), f);
+  }
+};
+
+// Cells stored in contiguous bricks of X*Y*Z cells, so that the 26 neighbours
+// of most cells share a few cache lines. Bricks are laid out in row-major
+// order, and so are cells within a brick. Bricks on the upper boundaries are
+// truncated to the cube, so storage is not padded.
+// Powers of two keep the index computation free of divisions.
+template <size_t X, size_t Y, size_t Z>
+struct brick_layout {
+  static constexpr bool padded = false;
+  static constexpr size_t x = X;
+  static constexpr size_t y = Y;
+  static constexpr size_t z = Z;
+
+  static size_t size(const cube_index & n) { return n.volume(); }
+
+  static size_t index(size_t i, size_t j, size_t k, const cube_index & n);
+
+  template <class F>
+  static void visit(F f, const cube_index & n, size_t first, size_t last);
+};
+
+template <size_t X, size_t Y, size_t Z>
+constexpr size_t brick_layout<X,Y,Z>::x;
+
+template <size_t X, size_t Y, size_t Z>
+constexpr size_t brick_layout<X,Y,Z>::y;
+
+template <size_t X, size_t Y, size_t Z>
+constexpr size_t brick_layout<X,Y,Z>::z;
+
+template <size_t X, size_t Y, size_t Z>
+size_t brick_layout<X,Y,Z>::index(size_t i, size_t j, size_t k, const cube_index & n)
+{
+  const size_t nx = n.get<0>();
+  const size_t ny = n.get<1>();
+  const size_t i0 = i - i % X;
+  const size_t j0 = j - j % Y;
+  const size_t k0 = k - k % Z;
+  const size_t tx = std::min<size_t>(X, nx - i0);
+  const size_t ty = std::min<size_t>(Y, ny - j0);
+  const size_t tz = std::min<size_t>(Z, n.get<2>() - k0);
+  // Full slabs below k0, brick rows below j0 and bricks left of i0
+  const size_t brick = nx * ny * k0 + nx * tz * j0 + ty * tz * i0;
+  return brick + (i - i0) + tx * ((j - j0) + ty * (k - k0));
+}
+
+template <size_t X, size_t Y, size_t Z>
+template <class F>
+void brick_layout<X,Y,Z>::visit(F f, const cube_index & n, size_t first, size_t last)
+{
+  const size_t nx = n.get<0>();
+  const size_t ny = n.get<1>();
+  const size_t nz = n.get<2>();
+  size_t p = first;
+  while (p != last) {
+    // Locate the brick holding position p
+    const size_t k0 = p / (nx * ny * Z) * Z;
+    const size_t tz = std::min<size_t>(Z, nz - k0);
+    size_t r = p - nx * ny * k0;
+    const size_t j0 = r / (nx * Y * tz) * Y;
+    const size_t ty = std::min<size_t>(Y, ny - j0);
+    r -= nx * tz * j0;
+    const size_t i0 = r / (X * ty * tz) * X;
+    const size_t tx = std::min<size_t>(X, nx - i0);
+    r -= ty * tz * i0;
+
+    size_t i = r % tx;
+    size_t j = (r / tx) % ty;
+    size_t k = r / (tx * ty);
+    const size_t end = std::min(last, p - r + tx * ty * tz);
+    for (; p != end; ++p) {
+      f(p, cube_index{i0 + i, j0 + j, k0 + k});
+      if (++i == tx) {
+        i = 0;
+        if (++j == ty) {
+          j = 0;
+          ++k;
+        }
+      }
+    }
+  }
+}
+
+// Bit manipulation for space filling curves
+namespace sfc {
+
+// Number of bits needed for coordinates in [0,n)
+inline unsigned bits(size_t n)
+{
+#if defined(__GNUC__)
+  return (n <= 1) ? 0 : 8 * sizeof(unsigned long long) - __builtin_clzll(n - 1);
+#else
+  unsigned b = 0;
+  while ((size_t{1} << b) < n) ++b;
+  return b;
+#endif
+}
+
+inline std::uint64_t mask(unsigned b) { return (std::uint64_t{1} << b) - 1; }
+
+// Spreads the 21 low bits of x so that there are two zeros between bits
+inline std::uint64_t spread3(std::uint64_t x)
+{
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffull;
+  x = (x | x << 16) & 0x1f0000ff0000ffull;
+  x = (x | x << 8)  & 0x100f00f00f00f00full;
+  x = (x | x << 4)  & 0x10c30c30c30c30c3ull;
+  x = (x | x << 2)  & 0x1249249249249249ull;
+  return x;
+}
+
+// Inverse of spread3
+inline std::uint64_t compact3(std::uint64_t x)
+{
+  x &= 0x1249249249249249ull;
+  x = (x ^ (x >> 2))  & 0x10c30c30c30c30c3ull;
+  x = (x ^ (x >> 4))  & 0x100f00f00f00f00full;
+  x = (x ^ (x >> 8))  & 0x1f0000ff0000ffull;
+  x = (x ^ (x >> 16)) & 0x1f00000000ffffull;
+  x = (x ^ (x >> 32)) & 0x1fffff;
+  return x;
+}
+
+// Spreads the 32 low bits of x so that there is a zero between bits
+inline std::uint64_t spread2(std::uint64_t x)
+{
+  x &= 0xffffffffull;
+  x = (x | x << 16) & 0x0000ffff0000ffffull;
+  x = (x | x << 8)  & 0x00ff00ff00ff00ffull;
+  x = (x | x << 4)  & 0x0f0f0f0f0f0f0f0full;
+  x = (x | x << 2)  & 0x3333333333333333ull;
+  x = (x | x << 1)  & 0x5555555555555555ull;
+  return x;
+}
+
+// Inverse of spread2
+inline std::uint64_t compact2(std::uint64_t x)
+{
+  x &= 0x5555555555555555ull;
+  x = (x ^ (x >> 1))  & 0x3333333333333333ull;
+  x = (x ^ (x >> 2))  & 0x0f0f0f0f0f0f0f0full;
+  x = (x ^ (x >> 4))  & 0x00ff00ff00ff00ffull;
+  x = (x ^ (x >> 8))  & 0x0000ffff0000ffffull;
+  x = (x ^ (x >> 16)) & 0x00000000ffffffffull;
+  return x;
+}
+
+}
+
+// Cells stored in Z-order (Morton order) over the cube padded to a power of
+// two on every axis. Axes with fewer bits drop out of the interleaving once
+// exhausted, so storage is at most 8 times the cube volume and usually far
+// less. Consecutive storage ranges are compact in space, whatever the grid
+// size.
+struct morton_layout {
+  static constexpr bool padded = true;
+
+  static size_t size(const cube_index & n) {
+    return size_t{1} << (sfc::bits(n.get<0>()) + sfc::bits(n.get<1>()) + sfc::bits(n.get<2>()));
+  }
+
+  static size_t index(size_t i, size_t j, size_t k, const cube_index & n);
+
+  template <class F>
+  static void visit(F f, const cube_index & n, size_t first, size_t last);
+
+private:
+  friend struct hilbert_layout;
+
+  static std::uint64_t encode(const std::uint64_t (&c)[3], const unsigned (&b)[3]);
+  static cube_index decode(std::uint64_t p, const unsigned (&b)[3]);
+};
+
+inline size_t morton_layout::index(size_t i, size_t j, size_t k, const cube_index & n)
+{
+  const unsigned b[3] = { sfc::bits(n.get<0>()), sfc::bits(n.get<1>()), sfc::bits(n.get<2>()) };
+  const std::uint64_t c[3] = { i, j, k };
+  return encode(c, b);
+}
+
+inline std::uint64_t morton_layout::encode(const std::uint64_t (&c)[3], const unsigned (&b)[3])
+{
+  const unsigned m3 = std::min(b[0], std::min(b[1], b[2]));
+
+  // Bits common to the three axes
+  std::uint64_t code = sfc::spread3(c[0] & sfc::mask(m3))
+      | sfc::spread3(c[1] & sfc::mask(m3)) << 1
+      | sfc::spread3(c[2] & sfc::mask(m3)) << 2;
+  unsigned shift = 3 * m3;
+
+  // Remaining bits of the two longer axes, then of the longest one
+  unsigned a0 = 3, a1 = 3;
+  for (unsigned a=0; a!=3; ++a) {
+    if (b[a] == m3) continue;
+    if (a0 == 3) a0 = a; else a1 = a;
+  }
+  if (a1 != 3) {
+    const unsigned m2 = std::min(b[a0], b[a1]) - m3;
+    code |= (sfc::spread2((c[a0] >> m3) & sfc::mask(m2))
+        | sfc::spread2((c[a1] >> m3) & sfc::mask(m2)) << 1) << shift;
+    shift += 2 * m2;
+    a0 = (b[a0] > b[a1]) ? a0 : a1;
+    code |= (c[a0] >> (m3 + m2)) << shift;
+  }
+  else if (a0 != 3) {
+    code |= (c[a0] >> m3) << shift;
+  }
+  return code;
+}
+
+inline cube_index morton_layout::decode(std::uint64_t p, const unsigned (&b)[3])
+{
+  const unsigned m3 = std::min(b[0], std::min(b[1], b[2]));
+  std::uint64_t c[3] = {
+    sfc::compact3(p) & sfc::mask(m3),
+    sfc::compact3(p >> 1) & sfc::mask(m3),
+    sfc::compact3(p >> 2) & sfc::mask(m3)
+  };
+  p >>= 3 * m3;
+
+  unsigned a0 = 3, a1 = 3;
+  for (unsigned a=0; a!=3; ++a) {
+    if (b[a] == m3) continue;
+    if (a0 == 3) a0 = a; else a1 = a;
+  }
+  if (a1 != 3) {
+    const unsigned m2 = std::min(b[a0], b[a1]) - m3;
+    c[a0] |= (sfc::compact2(p) & sfc::mask(m2)) << m3;
+    c[a1] |= (sfc::compact2(p >> 1) & sfc::mask(m2)) << m3;
+    p >>= 2 * m2;
+    a0 = (b[a0] > b[a1]) ? a0 : a1;
+    c[a0] |= p << (m3 + m2);
+  }
+  else if (a0 != 3) {
+    c[a0] |= p << m3;
+  }
+  return {size_t(c[0]), size_t(c[1]), size_t(c[2])};
+}
+
+template <class F>
+void morton_layout::visit(F f, const cube_index & n, size_t first, size_t last)
+{
+  const unsigned b[3] = { sfc::bits(n.get<0>()), sfc::bits(n.get<1>()), sfc::bits(n.get<2>()) };
+  for (auto p=first; p!=last; ++p) {
+    const cube_index i = decode(p, b);
+    if (i.get<0>() < n.get<0>() && i.get<1>() < n.get<1>() && i.get<2>() < n.get<2>()) {
+      f(p, i);
+    }
+  }
+}
+
+// Cells stored in Hilbert order. The grid padded to powers of two is split
+// in cubic tiles, whose side is the shortest padded axis, and tiles follow
+// each other in Morton order. Within a tile, consecutive cells are always
+// face neighbours, at the price of a more expensive index computation
+// (Skilling's transpose algorithm). A cubic grid is a single tile.
+// Padding is the same as in morton_layout, so anisotropic grids take at
+// most 8 times their volume.
+struct hilbert_layout {
+  static constexpr bool padded = true;
+
+  static size_t size(const cube_index & n) { return morton_layout::size(n); }
+
+  static size_t index(size_t i, size_t j, size_t k, const cube_index & n);
+
+  template <class F>
+  static void visit(F f, const cube_index & n, size_t first, size_t last);
+
+private:
+  // Bits per axis of the tiles grid, and bits of the tile side
+  static unsigned tile_bits(const cube_index & n, unsigned (&t)[3]) {
+    const unsigned b[3] = { sfc::bits(n.get<0>()), sfc::bits(n.get<1>()), sfc::bits(n.get<2>()) };
+    const unsigned m = std::min(b[0], std::min(b[1], b[2]));
+    for (int a=0; a!=3; ++a) {
+      t[a] = b[a] - m;
+    }
+    return m;
+  }
+
+  static std::uint64_t encode(std::uint64_t i, std::uint64_t j, std::uint64_t k, unsigned b);
+  static cube_index decode(std::uint64_t p, unsigned b);
+};
+
+inline size_t hilbert_layout::index(size_t i, size_t j, size_t k, const cube_index & n)
+{
+  unsigned t[3];
+  const unsigned m = tile_bits(n, t);
+  const std::uint64_t tile[3] = { i >> m, j >> m, k >> m };
+  const std::uint64_t cell = encode(i & sfc::mask(m), j & sfc::mask(m), k & sfc::mask(m), m);
+  return morton_layout::encode(tile, t) << (3 * m) | cell;
+}
+
+// Hilbert index of (i,j,k) in a cube of side 2^b
+inline std::uint64_t hilbert_layout::encode(std::uint64_t i, std::uint64_t j, std::uint64_t k, unsigned b)
+{
+  if (b == 0) return 0;
+  std::uint64_t x[3] = { i, j, k };
+
+  // Inverse undo
+  const std::uint64_t m = std::uint64_t{1} << (b - 1);
+  for (std::uint64_t q=m; q>1; q>>=1) {
+    const std::uint64_t p = q - 1;
+    for (int a=0; a!=3; ++a) {
+      if (x[a] & q) {
+        x[0] ^= p;
+      }
+      else {
+        const std::uint64_t t = (x[0] ^ x[a]) & p;
+        x[0] ^= t;
+        x[a] ^= t;
+      }
+    }
+  }
+
+  // Gray encode
+  x[1] ^= x[0];
+  x[2] ^= x[1];
+  std::uint64_t t = 0;
+  for (std::uint64_t q=m; q>1; q>>=1) {
+    if (x[2] & q) t ^= q - 1;
+  }
+  x[0] ^= t;
+  x[1] ^= t;
+  x[2] ^= t;
+
+  return sfc::spread3(x[2]) | sfc::spread3(x[1]) << 1 | sfc::spread3(x[0]) << 2;
+}
+
+inline cube_index hilbert_layout::decode(std::uint64_t p, unsigned b)
+{
+  if (b == 0) return {0, 0, 0};
+  std::uint64_t x[3] = { sfc::compact3(p >> 2), sfc::compact3(p >> 1), sfc::compact3(p) };
+
+  // Gray decode
+  std::uint64_t t = x[2] >> 1;
+  x[2] ^= x[1];
+  x[1] ^= x[0];
+  x[0] ^= t;
+
+  // Undo excess work
+  const std::uint64_t n = std::uint64_t{2} << (b - 1);
+  for (std::uint64_t q=2; q!=n; q<<=1) {
+    const std::uint64_t r = q - 1;
+    for (int a=2; a>=0; --a) {
+      if (x[a] & q) {
+        x[0] ^= r;
+      }
+      else {
+        t = (x[0] ^ x[a]) & r;
+        x[0] ^= t;
+        x[a] ^= t;
+      }
+    }
+  }
+  return {size_t(x[0]), size_t(x[1]), size_t(x[2])};
+}
+
+template <class F>
+void hilbert_layout::visit(F f, const cube_index & n, size_t first, size_t last)
+{
+  unsigned t[3];
+  const unsigned m = tile_bits(n, t);
+  for (auto p=first; p!=last; ++p) {
+    const cube_index tile = morton_layout::decode(p >> (3 * m), t);
+    const cube_index cell = decode(p & sfc::mask(3 * m), m);
+    const cube_index i{
+      tile.get<0>() << m | cell.get<0>(),
+      tile.get<1>() << m | cell.get<1>(),
+      tile.get<2>() << m | cell.get<2>()
+    };
+    if (i.get<0>() < n.get<0>() && i.get<1>() < n.get<1>() && i.get<2>() < n.get<2>()) {
+      f(p, i);
+    }
+  }
+}
+
+// Storage position of the cell i, whose row-major position is q
+inline size_t storage_position(size_t q, const cube_index &, const cube_index &, row_major_layout)
+{
+  return q;
+}
+
+template <class L>
+size_t storage_position(size_t, const cube_index & i, const cube_index & n, L)
+{
+  return L::index(i.get<0>(), i.get<1>(), i.get<2>(), n);
+}
+
+}
+
+#endif
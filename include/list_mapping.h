@@ -22,6 +22,8 @@ SOFTWARE.
 #ifndef YAPL_LIST_MAPPING_H
 #define YAPL_LIST_MAPPING_H
 
+#include "reduction.h"
+
 namespace yapl {
 
 template <class S>
@@ -40,6 +42,12 @@ public:
   template <class BF, class LM, class MF>
   void apply_cartesian_unique(BF bf, LM lm, MF mf) { pstruc_->apply_cartesian_unique(bf,lm,mf); }
 
+  template <class V, class R, class M = unordered_reduction>
+  V reduce(V init, R r, M mode = M{}) { return pstruc_->transform_reduce(init, r, identity_transform{}, mode); }
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce(V init, R r, F f, M mode = M{}) { return pstruc_->transform_reduce(init, r, f, mode); }
+
 public:
   S * pstruc_;
 };
@@ -60,6 +68,12 @@ public:
   template <class BF, class LM, class MF>
   void apply_cartesian_unique(BF bf, LM lm, MF mf) { pstruc_->apply_cartesian_unique(bf,lm,mf); }
 
+  template <class V, class R, class M = unordered_reduction>
+  V reduce(V init, R r, M mode = M{}) { return pstruc_->transform_reduce(init, r, identity_transform{}, mode); }
+
+  template <class V, class R, class F, class M = unordered_reduction>
+  V transform_reduce(V init, R r, F f, M mode = M{}) { return pstruc_->transform_reduce(init, r, f, mode); }
+
 private:
   const S * pstruc_;
 };
@@ -0,0 +1,306 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_OPENMP_EXECUTOR_H
+#define YAPL_OPENMP_EXECUTOR_H
+
+#include "cube_index.h"
+#include "partitioner.h"
+#include "reduction.h"
+#include <omp.h>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+
+namespace yapl {
+
+class omp_mutex {
+public:
+  omp_mutex() { omp_init_lock(&lock_); }
+  ~omp_mutex() { omp_destroy_lock(&lock_); }
+
+  omp_mutex(const omp_mutex &) = delete;
+  omp_mutex & operator=(const omp_mutex &) = delete;
+
+  void lock() { omp_set_lock(&lock_); }
+  bool try_lock() { return omp_test_lock(&lock_) != 0; }
+  void unlock() { omp_unset_lock(&lock_); }
+private:
+  omp_lock_t lock_;
+};
+
+// Executor based on OpenMP worksharing loops. It shares the OpenMP runtime
+// thread team with the rest of the application, so it does not oversubscribe
+// cores when mixed with other OpenMP regions.
+template <class T>
+class openmp_executor {
+public:
+  using mutex_type = omp_mutex;
+
+  template <typename F>
+  static void apply(F f, T * b, size_t n);
+
+  template <typename F>
+  static void apply(F f, T * b, size_t nx, size_t ny, size_t nz);
+
+  template <typename F, typename Part, typename = requires_partitioner<Part>>
+  static void apply(F f, T * b, size_t n, size_t grain, Part & part);
+
+  template <typename F, typename Part>
+  static void apply(F f, T * b, size_t nx, size_t ny, size_t nz, Part & part);
+
+  template <typename F>
+  static void apply_ordered(F f, T * b, size_t n);
+
+  template <typename F>
+  static void apply_ordered(F f, T * b, size_t nx, size_t ny, size_t nz);
+
+  template <typename F, typename C>
+  static void apply_ordered(F f, C c, T * b, size_t n);
+
+  template <typename F, typename C>
+  static void apply_ordered(F f, C c, T * b, size_t nx, size_t ny, size_t nz);
+
+  // Calls f(first,last) on non-empty subranges covering [0,n)
+  template <typename F, typename Part>
+  static void apply_range(F f, size_t n, size_t grain, Part & part);
+
+  // Reduces [0,n), where g(first,last) returns the reduction of a non-empty
+  // subrange. The result is r(init, reduction of all subranges).
+  template <typename V, typename R, typename G>
+  static V reduce_range(size_t n, V init, R r, G g, unordered_reduction);
+
+  template <typename V, typename R, typename G>
+  static V reduce_range(size_t n, V init, R r, G g, deterministic_reduction);
+
+private:
+  static constexpr size_t max_ordered_chunk = 4096;
+
+  // Computes chunks in parallel and retires them with an ordered construct
+  template <typename R, typename F, typename C>
+  static void ordered_chunks(size_t n, F f, C c);
+};
+
+template <class T>
+constexpr size_t openmp_executor<T>::max_ordered_chunk;
+
+template <class T>
+template <class F>
+void openmp_executor<T>::apply(F f, T * b, size_t n)
+{
+  default_partitioner part;
+  apply(f, b, n, 0, part);
+}
+
+template <class T>
+template <class F>
+void openmp_executor<T>::apply(F f, T * b, size_t nx, size_t ny, size_t nz)
+{
+  default_partitioner part;
+  apply(f, b, nx, ny, nz, part);
+}
+
+// Static scheduling assigns the same iterations to the same threads on every
+// sweep. A non-zero grain switches to dynamic scheduling with that chunk size.
+// Partitioners are ignored.
+template <class T>
+template <class F, class Part, class>
+void openmp_executor<T>::apply(F f, T * b, size_t n, size_t grain, Part &)
+{
+  if (grain==0) {
+    #pragma omp parallel for schedule(static)
+    for (size_t i=0; i<n; ++i) {
+      f(b[i]);
+    }
+  }
+  else {
+    #pragma omp parallel for schedule(dynamic,grain)
+    for (size_t i=0; i<n; ++i) {
+      f(b[i]);
+    }
+  }
+}
+
+template <class T>
+template <class F, class Part>
+void openmp_executor<T>::apply(F f, T * b, size_t nx, size_t ny, size_t nz, Part &)
+{
+  #pragma omp parallel for collapse(3)
+  for (size_t k=0; k<nz; ++k) {
+    for (size_t j=0; j<ny; ++j) {
+      for (size_t i=0; i<nx; ++i) {
+        f(b[i + nx * (j + k * ny)], cube_index{i,j,k});
+      }
+    }
+  }
+}
+
+template <class T>
+template <class F>
+void openmp_executor<T>::apply_ordered(F f, T * b, size_t n)
+{
+  auto end = b + n;
+  for (;b!=end;++b) {
+    f(*b);
+  }
+}
+
+template <class T>
+template <class F>
+void openmp_executor<T>::apply_ordered(F f, T * b, size_t nx, size_t ny, size_t nz)
+{
+  for (size_t k=0; k!=nz; ++k) {
+    for (size_t j=0; j!=ny; ++j) {
+      for (size_t i=0; i!=nx; ++i, ++b) {
+        f(*b, cube_index{i,j,k});
+      }
+    }
+  }
+}
+
+template <class T>
+template <class F, class C>
+void openmp_executor<T>::apply_ordered(F f, C c, T * b, size_t n)
+{
+  using result_type = typename std::decay<typename std::result_of<F(T&)>::type>::type;
+  ordered_chunks<result_type>(n,
+    [f,b](size_t first, size_t last, std::vector<result_type> & v) {
+      for (auto i=first; i!=last; ++i) {
+        v.push_back(f(b[i]));
+      }
+    },
+    c
+  );
+}
+
+template <class T>
+template <class F, class C>
+void openmp_executor<T>::apply_ordered(F f, C c, T * b, size_t nx, size_t ny, size_t nz)
+{
+  using result_type = typename std::decay<
+      typename std::result_of<F(T&, const cube_index &)>::type>::type;
+  ordered_chunks<result_type>(nx * ny * nz,
+    [f,b,nx,ny](size_t first, size_t last, std::vector<result_type> & v) {
+      for_each_index(first, last, nx, ny, [f,b,&v](size_t p, const cube_index & i) {
+        v.push_back(f(b[p], i));
+      });
+    },
+    c
+  );
+}
+
+template <class T>
+template <class R, class F, class C>
+void openmp_executor<T>::ordered_chunks(size_t n, F f, C c)
+{
+  if (n==0) return;
+  const size_t nthreads = omp_get_max_threads();
+  const size_t chunk = std::max<size_t>(1,
+      std::min<size_t>(max_ordered_chunk, (n + 4 * nthreads - 1) / (4 * nthreads)));
+  const size_t nchunks = (n + chunk - 1) / chunk;
+
+  // Round-robin scheduling lets every thread compute its next chunk while
+  // waiting for its turn in the ordered region.
+  #pragma omp parallel for ordered schedule(static,1)
+  for (size_t ch=0; ch<nchunks; ++ch) {
+    std::vector<R> v;
+    const size_t first = ch * chunk;
+    f(first, std::min(n, first + chunk), v);
+    #pragma omp ordered
+    {
+      for (auto & r : v) {
+        c(r);
+      }
+    }
+  }
+}
+
+// Without a grain every thread gets one contiguous subrange, as with static
+// scheduling. Otherwise chunks of grain elements are dealt dynamically.
+template <class T>
+template <class F, class Part>
+void openmp_executor<T>::apply_range(F f, size_t n, size_t grain, Part &)
+{
+  if (n==0) return;
+  if (grain==0) {
+    #pragma omp parallel
+    {
+      const size_t nthreads = omp_get_num_threads();
+      const size_t id = omp_get_thread_num();
+      const size_t first = n * id / nthreads;
+      const size_t last = n * (id + 1) / nthreads;
+      if (first!=last) f(first, last);
+    }
+  }
+  else {
+    const size_t nchunks = (n + grain - 1) / grain;
+    #pragma omp parallel for schedule(dynamic,1)
+    for (size_t ch=0; ch<nchunks; ++ch) {
+      f(ch * grain, std::min(n, (ch + 1) * grain));
+    }
+  }
+}
+
+template <class T>
+template <class V, class R, class G>
+V openmp_executor<T>::reduce_range(size_t n, V init, R r, G g, unordered_reduction)
+{
+  // One partial result per thread, each one over a contiguous static block
+  const size_t nthreads = omp_get_max_threads();
+  std::vector<partial_result<V>> partials(nthreads, partial_result<V>{init});
+  std::vector<char> valid(nthreads, 0);
+  #pragma omp parallel num_threads(nthreads)
+  {
+    const size_t tid = omp_get_thread_num();
+    const size_t nt = omp_get_num_threads();
+    const size_t first = n * tid / nt;
+    const size_t last = n * (tid + 1) / nt;
+    if (first!=last) {
+      partials[tid].value = g(first, last);
+      valid[tid] = 1;
+    }
+  }
+  for (size_t t=0; t!=nthreads; ++t) {
+    if (valid[t]) {
+      init = r(init, partials[t].value);
+    }
+  }
+  return init;
+}
+
+template <class T>
+template <class V, class R, class G>
+V openmp_executor<T>::reduce_range(size_t n, V init, R r, G g, deterministic_reduction)
+{
+  const size_t chunk = deterministic_reduction::chunk_size();
+  const size_t nchunks = (n + chunk - 1) / chunk;
+  std::vector<partial_result<V>> partials(nchunks, partial_result<V>{init});
+  #pragma omp parallel for
+  for (size_t c=0; c<nchunks; ++c) {
+    partials[c].value = g(c * chunk, std::min(n, (c + 1) * chunk));
+  }
+  return fold_partials(init, r, partials);
+}
+
+}
+
+#endif
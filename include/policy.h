@@ -23,16 +23,48 @@ SOFTWARE.
 #define YAPL_POLICY_H
 
 #include "seqexecutor.h"
+#include "partitioner.h"
+#include "allocation.h"
+#include "layout.h"
+#include <cstddef>
 
 // Defines policies for running yapl
 
 namespace yapl {
 
-template <typename E>
+// Executor E running on elements of type U instead
+template <typename E, typename U>
+struct rebind_executor;
+
+template <template <class...> class E, typename T, typename ... R, typename U>
+struct rebind_executor<E<T,R...>, U> {
+  using type = E<U,R...>;
+};
+
+// E: Executor type.
+// Part: Partitioner used by the executor. Every block keeps its own
+//       partitioner object, so stateful partitioners (e.g. an affinity
+//       partitioner) are reused across calls.
+// G: Grain size for flat sweeps (0 lets the executor decide).
+// A: Allocation strategy for block storage (see allocation.h).
+// L: Storage layout of cube cells (see layout.h).
+template <typename E, typename Part = default_partitioner, size_t G = 0,
+          typename A = new_allocation, typename L = row_major_layout>
 struct policy {
   using executor_type = E;
+  using partitioner_type = Part;
+  static constexpr size_t grain_size = G;
+  using allocation_type = A;
+  using layout_type = L;
+
+  // Same policy for blocks of elements of type U
+  template <typename U>
+  using rebind = policy<typename rebind_executor<E,U>::type, Part, G, A, L>;
 };
 
+template <typename E, typename Part, size_t G, typename A, typename L>
+constexpr size_t policy<E,Part,G,A,L>::grain_size;
+
 template <typename T>
 using default_policy = policy<sequential_executor<T>>;
 
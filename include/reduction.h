@@ -0,0 +1,89 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_REDUCTION_H
+#define YAPL_REDUCTION_H
+
+#include <vector>
+#include <cstddef>
+
+namespace yapl {
+
+// Reduction modes.
+//
+// unordered_reduction: Partial results are split as the executor prefers.
+// The reduction operation must be associative. Floating point results may
+// change with the number of threads.
+//
+// deterministic_reduction: Partial results are always computed over the same
+// fixed chunks and combined left to right, so results are bit-identical for
+// any executor and any number of threads.
+struct unordered_reduction {};
+
+struct deterministic_reduction {
+  static constexpr size_t chunk_size() { return 1024; }
+};
+
+// Transformation used to reduce elements without transforming them
+struct identity_transform {
+  template <class U>
+  U & operator()(U & x) const { return x; }
+};
+
+// Partial result of a chunk (avoids packing of std::vector<bool>)
+template <class V>
+struct partial_result {
+  V value;
+};
+
+// Partial result of a chunk that may hold no element, such as a chunk of
+// padding in a space filling curve layout
+template <class V>
+struct optional_partial {
+  bool valid;
+  V value;
+};
+
+// Combines optional partials with r, skipping the empty ones
+template <class V, class R>
+struct optional_partial_combiner {
+  R r;
+
+  optional_partial<V> operator()(const optional_partial<V> & a, const optional_partial<V> & b) const {
+    if (!b.valid) return a;
+    if (!a.valid) return b;
+    return {true, r(a.value, b.value)};
+  }
+};
+
+// Combines the partial results of consecutive chunks from left to right
+template <class V, class R>
+V fold_partials(V init, R r, const std::vector<partial_result<V>> & partials)
+{
+  for (auto & p : partials) {
+    init = r(init, p.value);
+  }
+  return init;
+}
+
+}
+
+#endif
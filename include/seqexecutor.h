@@ -23,6 +23,9 @@ SOFTWARE.
 #define YAPL_SEQUENTIAL_EXECUTOR_H
 
 #include "cube_index.h"
+#include "partitioner.h"
+#include "reduction.h"
+#include <algorithm>
 #include <cstddef>
 
 namespace yapl {
@@ -46,11 +49,36 @@ public:
   template <typename F>
   static void apply(F f, T * b, size_t nx, size_t ny, size_t nz);
 
+  template <typename F, typename Part, typename = requires_partitioner<Part>>
+  static void apply(F f, T * b, size_t n, size_t grain, Part & part);
+
+  template <typename F, typename Part>
+  static void apply(F f, T * b, size_t nx, size_t ny, size_t nz, Part & part);
+
   template <typename F>
   static void apply_ordered(F f, T * b, size_t n);
 
   template <typename F>
   static void apply_ordered(F f, T * b, size_t nx, size_t ny, size_t nz);
+
+  // Ordered apply in two phases: results of f are passed to c in element order
+  template <typename F, typename C>
+  static void apply_ordered(F f, C c, T * b, size_t n);
+
+  template <typename F, typename C>
+  static void apply_ordered(F f, C c, T * b, size_t nx, size_t ny, size_t nz);
+
+  // Calls f(first,last) on non-empty subranges covering [0,n)
+  template <typename F, typename Part>
+  static void apply_range(F f, size_t n, size_t grain, Part & part);
+
+  // Reduces [0,n), where g(first,last) returns the reduction of a non-empty
+  // subrange. The result is r(init, reduction of all subranges).
+  template <typename V, typename R, typename G>
+  static V reduce_range(size_t n, V init, R r, G g, unordered_reduction);
+
+  template <typename V, typename R, typename G>
+  static V reduce_range(size_t n, V init, R r, G g, deterministic_reduction);
 };
 
 template <class T>
@@ -76,6 +104,20 @@ void sequential_executor<T>::apply(F f, T * b, size_t nx, size_t ny, size_t nz)
   }
 }
 
+template <class T>
+template <class F, class Part, class>
+void sequential_executor<T>::apply(F f, T * b, size_t n, size_t, Part &)
+{
+  apply(f, b, n);
+}
+
+template <class T>
+template <class F, class Part>
+void sequential_executor<T>::apply(F f, T * b, size_t nx, size_t ny, size_t nz, Part &)
+{
+  apply(f, b, nx, ny, nz);
+}
+
 template <class T>
 template <class F>
 void sequential_executor<T>::apply_ordered(F f, T * b, size_t n)
@@ -99,6 +141,54 @@ void sequential_executor<T>::apply_ordered(F f, T * b, size_t nx, size_t ny, siz
   }
 }
 
+template <class T>
+template <class F, class C>
+void sequential_executor<T>::apply_ordered(F f, C c, T * b, size_t n)
+{
+  auto end = b + n;
+  for (;b!=end;++b) {
+    c(f(*b));
+  }
+}
+
+template <class T>
+template <class F, class C>
+void sequential_executor<T>::apply_ordered(F f, C c, T * b, size_t nx, size_t ny, size_t nz)
+{
+  for (size_t k=0; k!=nz; ++k) {
+    for (size_t j=0; j!=ny; ++j) {
+      for (size_t i=0; i!=nx; ++i, ++b) {
+        c(f(*b, cube_index{i,j,k}));
+      }
+    }
+  }
+}
+
+template <class T>
+template <class F, class Part>
+void sequential_executor<T>::apply_range(F f, size_t n, size_t, Part &)
+{
+  if (n!=0) f(size_t{0}, n);
+}
+
+template <class T>
+template <class V, class R, class G>
+V sequential_executor<T>::reduce_range(size_t n, V init, R r, G g, unordered_reduction)
+{
+  return (n==0) ? init : r(init, g(0,n));
+}
+
+template <class T>
+template <class V, class R, class G>
+V sequential_executor<T>::reduce_range(size_t n, V init, R r, G g, deterministic_reduction)
+{
+  const size_t chunk = deterministic_reduction::chunk_size();
+  for (size_t first=0; first<n; first+=chunk) {
+    init = r(init, g(first, std::min(n, first + chunk)));
+  }
+  return init;
+}
+
 }
 
 #endif
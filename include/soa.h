@@ -0,0 +1,522 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_SOA_H
+#define YAPL_SOA_H
+
+#include "allocation.h"
+#include "block.h"
+#include "cube_index.h"
+#include <tuple>
+#include <memory>
+#include <type_traits>
+
+namespace yapl {
+
+// Cell type made of the fields Ts, stored as a structure of arrays.
+// A cube<soa<double,double,double>,P> keeps one contiguous array per field,
+// so that sweeps touching a few fields only stream those arrays.
+template <class ... Ts>
+struct soa {};
+
+template <size_t ... I>
+struct index_list {};
+
+template <size_t N, size_t ... I>
+struct make_index_list : make_index_list<N-1, N-1, I...> {};
+
+template <size_t ... I>
+struct make_index_list<0, I...> {
+  using type = index_list<I...>;
+};
+
+// Proxy to the fields of a cell in a structure of arrays.
+// Assignments write through to the fields as with a plain reference.
+template <class ... Ts>
+class soa_reference {
+public:
+  using value_type = std::tuple<typename std::remove_const<Ts>::type...>;
+
+  template <size_t I>
+  using field_type = typename std::tuple_element<I, std::tuple<Ts...>>::type;
+
+  soa_reference(const std::tuple<Ts*...> & fields, size_t i) : fields_{fields}, index_{i} {}
+
+  soa_reference(const soa_reference &) = default;
+
+  template <size_t I>
+  field_type<I> & get() const { return std::get<I>(fields_)[index_]; }
+
+  operator value_type() const { return load(indices{}); }
+
+  const soa_reference & operator=(const value_type & v) const;
+  const soa_reference & operator=(const soa_reference & r) const { return *this = value_type(r); }
+
+private:
+  using indices = typename make_index_list<sizeof...(Ts)>::type;
+
+  template <size_t ... I>
+  value_type load(index_list<I...>) const { return value_type{get<I>()...}; }
+
+  template <size_t ... I>
+  void store(const value_type & v, index_list<I...>) const;
+
+private:
+  std::tuple<Ts*...> fields_;
+  size_t index_;
+};
+
+template <class ... Ts>
+const soa_reference<Ts...> & soa_reference<Ts...>::operator=(const value_type & v) const
+{
+  store(v, indices{});
+  return *this;
+}
+
+template <class ... Ts>
+template <size_t ... I>
+void soa_reference<Ts...>::store(const value_type & v, index_list<I...>) const
+{
+  using expand = int[];
+  (void) expand{0, (get<I>() = std::get<I>(v), 0)...};
+}
+
+template <size_t I, class ... Ts>
+typename soa_reference<Ts...>::template field_type<I> & get(const soa_reference<Ts...> & r)
+{
+  return r.template get<I>();
+}
+
+// Block storing every field in its own block, with policy P rebound to the
+// field type, so each array gets the policy's allocation (alignment, huge
+// pages) and partitioning.
+// Whole cell sweeps pass soa_reference proxies to f. A single field can be
+// streamed at full bandwidth through field<I>(), which is a plain block.
+template <class ... Ts, class P>
+class block<soa<Ts...>, P> {
+  // Every field is allocated from a copy of the same allocation object
+  static_assert(!is_shared_allocation<typename P::allocation_type>::value,
+      "soa blocks need an allocation that gives each field its own storage");
+
+public:
+  using allocation_type = typename P::allocation_type;
+  using layout_type = typename P::layout_type;
+  using reference = soa_reference<Ts...>;
+  using const_reference = soa_reference<const Ts...>;
+
+  template <class U>
+  using rebound_block = block<U, typename P::template rebind<U>>;
+
+  template <size_t I>
+  using field_block_type = rebound_block<typename std::tuple_element<I, std::tuple<Ts...>>::type>;
+
+  block(size_t n, const allocation_type & a = allocation_type{});
+  block(size_t n, first_touch_init_t, const allocation_type & a = allocation_type{});
+  block(size_t n, no_init_t, const allocation_type & a = allocation_type{});
+
+  block(const block &) = delete;
+  block & operator=(const block &) = delete;
+
+  block(block &&) = default;
+  block & operator=(block &&) = default;
+
+  const allocation_type & get_allocation() const { return std::get<0>(fields_).get_allocation(); }
+
+  template <size_t I>
+  field_block_type<I> & field() { return std::get<I>(fields_); }
+
+  template <size_t I>
+  const field_block_type<I> & field() const { return std::get<I>(fields_); }
+
+  reference operator[](size_t i) { return reference{pointers(indices{}), i}; }
+  const_reference operator[](size_t i) const { return const_reference{pointers(indices{}), i}; }
+
+  template <class F>
+  void apply(F f, size_t n);
+
+  template <class F>
+  void apply_ordered(F f, size_t n);
+
+  template <class F>
+  void apply(F f, size_t n) const;
+
+  template <class F>
+  void apply_ordered(F f, size_t n) const;
+
+  template <class F>
+  void apply(F f, const cube_index & i);
+
+  template <class F>
+  void apply_ordered(F f, const cube_index & i);
+
+  template <class F>
+  void apply(F f, const cube_index & i) const;
+
+  template <class F>
+  void apply_ordered(F f, const cube_index & i) const;
+
+  template <class F, class C>
+  void apply_ordered(F f, C c, size_t n);
+
+  template <class F, class C>
+  void apply_ordered(F f, C c, size_t n) const;
+
+  template <class F, class C>
+  void apply_ordered(F f, C c, const cube_index & i);
+
+  template <class F, class C>
+  void apply_ordered(F f, C c, const cube_index & i) const;
+
+  template <class F, int I>
+  void apply_plane(F f, size_t p, const cube_index & i);
+
+  template <int I, class F>
+  void apply_plane_indexed(F f, size_t p, const cube_index & i);
+
+  template <class F>
+  void apply_region(F f, const cube_region & g, const cube_index & i);
+
+  template <class F>
+  void apply_region(F f, const cube_region & g, const cube_index & i) const;
+
+  template <class V, class R, class F, class M>
+  V transform_reduce(V init, R r, F f, size_t n, M mode) const;
+
+  template <class V, class R, class F, class M>
+  V transform_reduce(V init, R r, F f, const cube_index & i, M mode) const;
+
+  template <int I, class V, class R, class F, class M>
+  V transform_reduce_plane(V init, R r, F f, size_t p, const cube_index & i, M mode) const;
+
+  template <int I, class V, class R, class F, class M>
+  V transform_reduce_plane_indexed(V init, R r, F f, size_t p, const cube_index & i, M mode) const;
+
+  template <class V, class R, class F, class M>
+  V transform_reduce_region(V init, R r, F f, const cube_region & g, const cube_index & i, M mode) const;
+
+private:
+  using partitioner_type = typename P::partitioner_type;
+  using indices = typename make_index_list<sizeof...(Ts)>::type;
+
+  template <size_t ... I>
+  std::tuple<Ts*...> pointers(index_list<I...>) { return std::tuple<Ts*...>{std::get<I>(fields_).data()...}; }
+
+  template <size_t ... I>
+  std::tuple<const Ts*...> pointers(index_list<I...>) const { return std::tuple<const Ts*...>{std::get<I>(fields_).data()...}; }
+
+  template <class Ref, class Ptrs, class F>
+  void sweep(Ptrs fields, F f, size_t n) const;
+
+  template <class Ref, class Ptrs, class F>
+  void sweep(Ptrs fields, F f, const cube_index & i) const;
+
+  template <class Ref, class Ptrs, class F>
+  void sweep(Ptrs fields, F f, const cube_region & g, const cube_index & i) const;
+
+private:
+  std::tuple<rebound_block<Ts>...> fields_;
+  std::unique_ptr<partitioner_type> part_;
+};
+
+template <class ... Ts, class P>
+block<soa<Ts...>,P>::block(size_t n, const allocation_type & a)
+:
+fields_{rebound_block<Ts>{n, a}...},
+part_{new partitioner_type{}}
+{
+}
+
+template <class ... Ts, class P>
+block<soa<Ts...>,P>::block(size_t n, first_touch_init_t, const allocation_type & a)
+:
+fields_{rebound_block<Ts>{n, first_touch_init, a}...},
+part_{new partitioner_type{}}
+{
+}
+
+template <class ... Ts, class P>
+block<soa<Ts...>,P>::block(size_t n, no_init_t, const allocation_type & a)
+:
+fields_{rebound_block<Ts>{n, no_init, a}...},
+part_{new partitioner_type{}}
+{
+}
+
+template <class ... Ts, class P>
+template <class Ref, class Ptrs, class F>
+void block<soa<Ts...>,P>::sweep(Ptrs fields, F f, size_t n) const
+{
+  P::executor_type::apply_range([f,fields](size_t first, size_t last) {
+      for (auto i=first; i!=last; ++i) {
+        f(Ref{fields, i});
+      }
+    },
+    n, P::grain_size, *part_
+  );
+}
+
+template <class ... Ts, class P>
+template <class Ref, class Ptrs, class F>
+void block<soa<Ts...>,P>::sweep(Ptrs fields, F f, const cube_index & idx) const
+{
+  P::executor_type::apply_range([f,fields,idx](size_t first, size_t last) {
+      layout_type::visit([f,&fields](size_t p, const cube_index & i) {
+        f(Ref{fields, p}, i);
+      }, idx, first, last);
+    },
+    layout_type::size(idx), P::grain_size, *part_
+  );
+}
+
+template <class ... Ts, class P>
+template <class Ref, class Ptrs, class F>
+void block<soa<Ts...>,P>::sweep(Ptrs fields, F f, const cube_region & g, const cube_index & idx) const
+{
+  P::executor_type::apply_range([f,fields,g,idx](size_t first, size_t last) {
+      g.visit([f,&fields,&idx](size_t q, const cube_index & i) {
+        f(Ref{fields, storage_position(q, i, idx, layout_type{})}, i);
+      }, idx, first, last);
+    },
+    g.runs(), P::grain_size, *part_
+  );
+}
+
+template <class ... Ts, class P>
+template <class F>
+void block<soa<Ts...>,P>::apply(F f, size_t n)
+{
+  sweep<reference>(pointers(indices{}), f, n);
+}
+
+template <class ... Ts, class P>
+template <class F>
+void block<soa<Ts...>,P>::apply_ordered(F f, size_t n)
+{
+  for (size_t i=0; i!=n; ++i) {
+    f((*this)[i]);
+  }
+}
+
+template <class ... Ts, class P>
+template <class F>
+void block<soa<Ts...>,P>::apply(F f, size_t n) const
+{
+  sweep<const_reference>(pointers(indices{}), f, n);
+}
+
+template <class ... Ts, class P>
+template <class F>
+void block<soa<Ts...>,P>::apply_ordered(F f, size_t n) const
+{
+  for (size_t i=0; i!=n; ++i) {
+    f((*this)[i]);
+  }
+}
+
+template <class ... Ts, class P>
+template <class F>
+void block<soa<Ts...>,P>::apply(F f, const cube_index & idx)
+{
+  sweep<reference>(pointers(indices{}), f, idx);
+}
+
+template <class ... Ts, class P>
+template <class F>
+void block<soa<Ts...>,P>::apply_ordered(F f, const cube_index & idx)
+{
+  for_each_index(0, idx.volume(), idx.get<0>(), idx.get<1>(), [this,f,&idx](size_t q, const cube_index & i) {
+    f((*this)[storage_position(q, i, idx, layout_type{})], i);
+  });
+}
+
+template <class ... Ts, class P>
+template <class F>
+void block<soa<Ts...>,P>::apply(F f, const cube_index & idx) const
+{
+  sweep<const_reference>(pointers(indices{}), f, idx);
+}
+
+template <class ... Ts, class P>
+template <class F>
+void block<soa<Ts...>,P>::apply_ordered(F f, const cube_index & idx) const
+{
+  for_each_index(0, idx.volume(), idx.get<0>(), idx.get<1>(), [this,f,&idx](size_t q, const cube_index & i) {
+    f((*this)[storage_position(q, i, idx, layout_type{})], i);
+  });
+}
+
+template <class ... Ts, class P>
+template <class F, class C>
+void block<soa<Ts...>,P>::apply_ordered(F f, C c, size_t n)
+{
+  apply_ordered([f,&c](reference x) { c(f(x)); }, n);
+}
+
+template <class ... Ts, class P>
+template <class F, class C>
+void block<soa<Ts...>,P>::apply_ordered(F f, C c, size_t n) const
+{
+  apply_ordered([f,&c](const_reference x) { c(f(x)); }, n);
+}
+
+template <class ... Ts, class P>
+template <class F, class C>
+void block<soa<Ts...>,P>::apply_ordered(F f, C c, const cube_index & idx)
+{
+  apply_ordered([f,&c](reference x, const cube_index & i) { c(f(x,i)); }, idx);
+}
+
+template <class ... Ts, class P>
+template <class F, class C>
+void block<soa<Ts...>,P>::apply_ordered(F f, C c, const cube_index & idx) const
+{
+  apply_ordered([f,&c](const_reference x, const cube_index & i) { c(f(x,i)); }, idx);
+}
+
+template <class ... Ts, class P>
+template <class F, int I>
+void block<soa<Ts...>,P>::apply_plane(F f, size_t p, const cube_index & idx)
+{
+  apply_plane_indexed<I>([f](reference x, const cube_index &) { f(x); }, p, idx);
+}
+
+template <class ... Ts, class P>
+template <int I, class F>
+void block<soa<Ts...>,P>::apply_plane_indexed(F f, size_t p, const cube_index & idx)
+{
+  auto fields = pointers(indices{});
+  P::executor_type::apply_range([f,fields,p,idx](size_t first, size_t last) {
+      cube_plane<I>::visit([f,&fields,&idx](size_t q, const cube_index & i) {
+          f(reference{fields, storage_position(q, i, idx, layout_type{})}, i);
+        }, p, idx, first, last);
+    },
+    cube_plane<I>::size(idx), P::grain_size, *part_
+  );
+}
+
+template <class ... Ts, class P>
+template <class V, class R, class F, class M>
+V block<soa<Ts...>,P>::transform_reduce(V init, R r, F f, size_t n, M mode) const
+{
+  auto fields = pointers(indices{});
+  return P::executor_type::reduce_range(n, init, r,
+    [fields,r,f](size_t first, size_t last) -> V {
+      V acc = f(const_reference{fields, first});
+      for (auto i=first+1; i!=last; ++i) {
+        acc = r(acc, f(const_reference{fields, i}));
+      }
+      return acc;
+    },
+    mode
+  );
+}
+
+template <class ... Ts, class P>
+template <class V, class R, class F, class M>
+V block<soa<Ts...>,P>::transform_reduce(V init, R r, F f, const cube_index & idx, M mode) const
+{
+  // Chunks of a padded layout may hold no cell at all
+  using partial = optional_partial<V>;
+  auto fields = pointers(indices{});
+  return P::executor_type::reduce_range(layout_type::size(idx), partial{true, init},
+    optional_partial_combiner<V,R>{r},
+    [fields,r,f,idx,init](size_t first, size_t last) -> partial {
+      partial acc{false, init};
+      layout_type::visit([&fields,r,f,&acc](size_t p, const cube_index & i) {
+        acc.value = acc.valid ? r(acc.value, f(const_reference{fields, p}, i))
+                              : f(const_reference{fields, p}, i);
+        acc.valid = true;
+      }, idx, first, last);
+      return acc;
+    },
+    mode
+  ).value;
+}
+
+template <class ... Ts, class P>
+template <int I, class V, class R, class F, class M>
+V block<soa<Ts...>,P>::transform_reduce_plane(V init, R r, F f, size_t p, const cube_index & idx, M mode) const
+{
+  return transform_reduce_plane_indexed<I>(init, r,
+    [f](const_reference x, const cube_index &) { return f(x); },
+    p, idx, mode);
+}
+
+template <class ... Ts, class P>
+template <int I, class V, class R, class F, class M>
+V block<soa<Ts...>,P>::transform_reduce_plane_indexed(V init, R r, F f, size_t p, const cube_index & idx, M mode) const
+{
+  auto fields = pointers(indices{});
+  return P::executor_type::reduce_range(cube_plane<I>::size(idx), init, r,
+    [fields,r,f,p,idx,init](size_t first, size_t last) -> V {
+      V acc = init;
+      cube_plane<I>::visit([&fields,f,&acc,&idx](size_t q, const cube_index & i) {
+          acc = f(const_reference{fields, storage_position(q, i, idx, layout_type{})}, i);
+        }, p, idx, first, first+1);
+      cube_plane<I>::visit([&fields,r,f,&acc,&idx](size_t q, const cube_index & i) {
+          acc = r(acc, f(const_reference{fields, storage_position(q, i, idx, layout_type{})}, i));
+        }, p, idx, first+1, last);
+      return acc;
+    },
+    mode
+  );
+}
+
+template <class ... Ts, class P>
+template <class F>
+void block<soa<Ts...>,P>::apply_region(F f, const cube_region & g, const cube_index & idx)
+{
+  sweep<reference>(pointers(indices{}), f, g, idx);
+}
+
+template <class ... Ts, class P>
+template <class F>
+void block<soa<Ts...>,P>::apply_region(F f, const cube_region & g, const cube_index & idx) const
+{
+  sweep<const_reference>(pointers(indices{}), f, g, idx);
+}
+
+template <class ... Ts, class P>
+template <class V, class R, class F, class M>
+V block<soa<Ts...>,P>::transform_reduce_region(V init, R r, F f, const cube_region & g, const cube_index & idx, M mode) const
+{
+  auto fields = pointers(indices{});
+  return P::executor_type::reduce_range(g.runs(), init, r,
+    [fields,r,f,g,idx,init](size_t first, size_t last) -> V {
+      V acc = init;
+      const size_t x0 = g.lower().get<0>();
+      g.visit_run([&fields,f,&idx,&acc](size_t q, const cube_index & i) {
+          acc = f(const_reference{fields, storage_position(q, i, idx, layout_type{})}, i);
+        }, idx, first, x0, x0+1);
+      auto next = [&fields,r,f,&idx,&acc](size_t q, const cube_index & i) {
+          acc = r(acc, f(const_reference{fields, storage_position(q, i, idx, layout_type{})}, i));
+        };
+      g.visit_run(next, idx, first, x0+1, g.upper().get<0>());
+      g.visit(next, idx, first+1, last);
+      return acc;
+    },
+    mode
+  );
+}
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_STENCIL_H
+#define YAPL_STENCIL_H
+
+#include "cube.h"
+#include "cube_index.h"
+#include "layout.h"
+#include <cstddef>
+#include <type_traits>
+
+#ifndef NDEBUG
+#include <cassert>
+#endif
+
+// Tells the compiler that the next loop carries no dependences through
+// memory, so that it is vectorized without runtime aliasing checks
+#if defined(__clang__)
+#define YAPL_IVDEP _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define YAPL_IVDEP _Pragma("GCC ivdep")
+#else
+#define YAPL_IVDEP
+#endif
+
+namespace yapl {
+
+// Point of a stencil at offset (DX,DY,DZ) with integer weight W
+template <int DX, int DY, int DZ, int W = 1>
+struct stencil_point {
+  static constexpr int dx = DX;
+  static constexpr int dy = DY;
+  static constexpr int dz = DZ;
+  static constexpr int weight = W;
+};
+
+template <int DX, int DY, int DZ, int W>
+constexpr int stencil_point<DX,DY,DZ,W>::dx;
+
+template <int DX, int DY, int DZ, int W>
+constexpr int stencil_point<DX,DY,DZ,W>::dy;
+
+template <int DX, int DY, int DZ, int W>
+constexpr int stencil_point<DX,DY,DZ,W>::dz;
+
+template <int DX, int DY, int DZ, int W>
+constexpr int stencil_point<DX,DY,DZ,W>::weight;
+
+constexpr int stencil_abs(int x) { return (x<0) ? -x : x; }
+
+constexpr int stencil_max(int x, int y) { return (x<y) ? y : x; }
+
+// Unrolled weighted sums over the points of a stencil
+template <class ... Ps>
+struct stencil_terms;
+
+template <>
+struct stencil_terms<> {
+  static constexpr int reach = 0;
+
+  template <class T>
+  static T sum(const T *, std::ptrdiff_t, std::ptrdiff_t) { return T{}; }
+
+  template <class T, class G>
+  static T sum_with(G &) { return T{}; }
+};
+
+template <class P0, class ... Ps>
+struct stencil_terms<P0, Ps...> {
+  static constexpr int reach = stencil_max(
+      stencil_max(stencil_abs(P0::dx), stencil_abs(P0::dy)),
+      stencil_max(stencil_abs(P0::dz), stencil_terms<Ps...>::reach));
+
+  // Sum over the cells around p, in row-major storage with strides sy and sz
+  template <class T>
+  static T sum(const T * p, std::ptrdiff_t sy, std::ptrdiff_t sz) {
+    return T(P0::weight) * p[P0::dx + P0::dy * sy + P0::dz * sz] +
+        stencil_terms<Ps...>::sum(p, sy, sz);
+  }
+
+  // Sum over the cells returned by get(dx,dy,dz)
+  template <class T, class G>
+  static T sum_with(G & get) {
+    return T(P0::weight) * get(P0::dx, P0::dy, P0::dz) +
+        stencil_terms<Ps...>::template sum_with<T>(get);
+  }
+};
+
+// Linear stencil: the sum of the weighted points divided by D.
+// Shape and weights are fixed at compile time, so evaluation is fully
+// unrolled. Integer cell types divide with truncation.
+template <int D, class ... Ps>
+struct stencil {
+  static_assert(D != 0, "stencil denominator cannot be zero");
+
+  static constexpr size_t size = sizeof...(Ps);
+
+  // Largest offset on any axis
+  static constexpr int reach = stencil_terms<Ps...>::reach;
+
+  template <class T>
+  static T evaluate(const T * p, std::ptrdiff_t sy, std::ptrdiff_t sz) {
+    return scale(stencil_terms<Ps...>::sum(p, sy, sz));
+  }
+
+  template <class T, class G>
+  static T evaluate_with(G get) {
+    return scale(stencil_terms<Ps...>::template sum_with<T>(get));
+  }
+
+private:
+  template <class T>
+  static T scale(const T & x) { return (D==1) ? x : x / T(D); }
+};
+
+template <int D, class ... Ps>
+constexpr size_t stencil<D,Ps...>::size;
+
+template <int D, class ... Ps>
+constexpr int stencil<D,Ps...>::reach;
+
+// Discrete Laplacian on the 6 face neighbours
+using laplacian_7 = stencil<1,
+  stencil_point<0,0,0,-6>,
+  stencil_point<-1,0,0>, stencil_point<1,0,0>,
+  stencil_point<0,-1,0>, stencil_point<0,1,0>,
+  stencil_point<0,0,-1>, stencil_point<0,0,1>>;
+
+// Mean of a cell and its 6 face neighbours
+using average_7 = stencil<7,
+  stencil_point<0,0,0>,
+  stencil_point<-1,0,0>, stencil_point<1,0,0>,
+  stencil_point<0,-1,0>, stencil_point<0,1,0>,
+  stencil_point<0,0,-1>, stencil_point<0,0,1>>;
+
+// Mean of a cell and its 26 neighbours
+using average_27 = stencil<27,
+  stencil_point<-1,-1,-1>, stencil_point<0,-1,-1>, stencil_point<1,-1,-1>,
+  stencil_point<-1,0,-1>, stencil_point<0,0,-1>, stencil_point<1,0,-1>,
+  stencil_point<-1,1,-1>, stencil_point<0,1,-1>, stencil_point<1,1,-1>,
+  stencil_point<-1,-1,0>, stencil_point<0,-1,0>, stencil_point<1,-1,0>,
+  stencil_point<-1,0,0>, stencil_point<0,0,0>, stencil_point<1,0,0>,
+  stencil_point<-1,1,0>, stencil_point<0,1,0>, stencil_point<1,1,0>,
+  stencil_point<-1,-1,1>, stencil_point<0,-1,1>, stencil_point<1,-1,1>,
+  stencil_point<-1,0,1>, stencil_point<0,0,1>, stencil_point<1,0,1>,
+  stencil_point<-1,1,1>, stencil_point<0,1,1>, stencil_point<1,1,1>>;
+
+// Value of the cell of c at (x,y,z), which may lie outside the cube.
+// Outside cells are given by boundary policy b (see boundary.h).
+template <class T, class P, class B>
+T stencil_cell(const cube<T,P> & c, std::ptrdiff_t x, std::ptrdiff_t y, std::ptrdiff_t z, const B & b)
+{
+  const std::ptrdiff_t nx = c.size_x();
+  const std::ptrdiff_t ny = c.size_y();
+  const std::ptrdiff_t nz = c.size_z();
+  if ((x>=0 && x<nx) || b.map(x,nx)) {
+    if ((y>=0 && y<ny) || b.map(y,ny)) {
+      if ((z>=0 && z<nz) || b.map(z,nz)) {
+        return c(x,y,z);
+      }
+    }
+  }
+  T v{};
+  b.assign(v);
+  return v;
+}
+
+// Sets every cell of out to stencil S applied to the same cell of in, in
+// parallel under the policy executor. Cells outside in are given by boundary
+// policy b. Work is split in x-rows. In row-major cubes, rows far enough from
+// the boundary are swept as contiguous runs without boundary logic, which
+// compilers can vectorize. Rows are split with the partitioner of out, so
+// stateful partitioners replay their mapping across timesteps.
+template <class S, class T, class P, class B>
+void apply_stencil(const cube<T,P> & in, cube<T,P> & out, const B & b);
+
+template <class S, class T, class P, class B>
+void apply_stencil_row(const cube<T,P> & in, cube<T,P> & out, size_t y, size_t z, const B & b, row_major_layout)
+{
+  const std::ptrdiff_t nx = in.size_x();
+  const std::ptrdiff_t ny = in.size_y();
+  const std::ptrdiff_t nz = in.size_z();
+  const std::ptrdiff_t r = S::reach;
+  auto boundary_cell = [&in,&b,y,z](std::ptrdiff_t x) {
+    return S::template evaluate_with<T>([&](int dx, int dy, int dz) {
+      return stencil_cell(in, x+dx, std::ptrdiff_t(y)+dy, std::ptrdiff_t(z)+dz, b);
+    });
+  };
+  const std::ptrdiff_t yy = y;
+  const std::ptrdiff_t zz = z;
+  if (yy<r || yy>=ny-r || zz<r || zz>=nz-r || nx<=2*r) {
+    for (std::ptrdiff_t x=0; x<nx; ++x) {
+      out(x,y,z) = boundary_cell(x);
+    }
+    return;
+  }
+
+  const std::ptrdiff_t sy = nx;
+  const std::ptrdiff_t sz = nx * ny;
+  const T * src = &in(0,y,z);
+  T * dst = &out(0,y,z);
+  for (std::ptrdiff_t x=0; x<r; ++x) {
+    dst[x] = boundary_cell(x);
+  }
+  // in and out are different cubes
+  YAPL_IVDEP
+  for (std::ptrdiff_t x=r; x<nx-r; ++x) {
+    dst[x] = S::evaluate(src + x, sy, sz);
+  }
+  for (std::ptrdiff_t x=nx-r; x<nx; ++x) {
+    dst[x] = boundary_cell(x);
+  }
+}
+
+// Other layouts take every cell through the boundary checks
+template <class S, class T, class P, class B, class L>
+void apply_stencil_row(const cube<T,P> & in, cube<T,P> & out, size_t y, size_t z, const B & b, L)
+{
+  const std::ptrdiff_t nx = in.size_x();
+  for (std::ptrdiff_t x=0; x<nx; ++x) {
+    out(x,y,z) = S::template evaluate_with<T>([&](int dx, int dy, int dz) {
+      return stencil_cell(in, x+dx, std::ptrdiff_t(y)+dy, std::ptrdiff_t(z)+dz, b);
+    });
+  }
+}
+
+template <class S, class T, class P, class B>
+void apply_stencil(const cube<T,P> & in, cube<T,P> & out, const B & b)
+{
+#ifndef NDEBUG
+  assert(in.size_x()==out.size_x() && in.size_y()==out.size_y() && in.size_z()==out.size_z());
+  assert(&in != &out);
+#endif
+  const cube<T,P> * pin = &in;
+  cube<T,P> * pout = &out;
+  const size_t ny = in.size_y();
+  P::executor_type::apply_range([pin,pout,ny,&b](size_t first, size_t last) {
+      for (auto q=first; q!=last; ++q) {
+        apply_stencil_row<S>(*pin, *pout, q % ny, q / ny, b, typename P::layout_type{});
+      }
+    },
+    ny * in.size_z(), P::grain_size, out.partitioner()
+  );
+}
+
+}
+
+#undef YAPL_IVDEP
+
+#endif
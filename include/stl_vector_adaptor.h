@@ -87,6 +87,24 @@ public:
     }
   }
 
+  template <typename V, typename R, typename F, typename M>
+  V transform_reduce(V init, R r, F f, M mode) const {
+    mtx_.lock();
+    const T * b = vec_.data();
+    size_t n = vec_.size();
+    mtx_.unlock();
+    return P::executor_type::reduce_range(n, init, r,
+      [b,r,f](size_t first, size_t last) -> V {
+        V acc = f(b[first]);
+        for (auto i=first+1; i!=last; ++i) {
+          acc = r(acc, f(b[i]));
+        }
+        return acc;
+      },
+      mode
+    );
+  }
+
   template <typename BF, typename M, typename MF>
   void apply_cartesian_unique(BF bf, M om, MF mf) {
     auto first = vec_.begin();
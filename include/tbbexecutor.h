@@ -23,7 +23,13 @@ SOFTWARE.
 #define YAPL_TBB_EXECUTOR_H
 
 #include "cube_index.h"
+#include "tile_shape.h"
+#include "partitioner.h"
+#include "reduction.h"
 #include <tbb/tbb.h>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
 #include <cstddef>
 
 namespace yapl {
@@ -37,7 +43,14 @@ private:
   tbb::spin_mutex m_;
 };
 
-template <class T>
+#if TBB_VERSION_MAJOR >= 2021
+using tbb_filter_mode = tbb::filter_mode;
+#else
+using tbb_filter_mode = tbb::filter::mode;
+#endif
+
+// Indexed sweeps are split in 3D tiles of shape S (see tile_shape.h)
+template <class T, class S = default_tile_shape>
 class tbb_executor {
 public:
   using mutex_type = spin_mutex;
@@ -48,43 +61,114 @@ public:
   template <typename F>
   static void apply(F f, T * b, size_t nx, size_t ny, size_t nz);
 
+  template <typename F, typename Part, typename = requires_partitioner<Part>>
+  static void apply(F f, T * b, size_t n, size_t grain, Part & part);
+
+  template <typename F, typename Part>
+  static void apply(F f, T * b, size_t nx, size_t ny, size_t nz, Part & part);
+
   template <typename F>
   static void apply_ordered(F f, T * b, size_t n);
 
   template <typename F>
   static void apply_ordered(F f, T * b, size_t nx, size_t ny, size_t nz);
+
+  template <typename F, typename C>
+  static void apply_ordered(F f, C c, T * b, size_t n);
+
+  template <typename F, typename C>
+  static void apply_ordered(F f, C c, T * b, size_t nx, size_t ny, size_t nz);
+
+  // Calls f(first,last) on non-empty subranges covering [0,n)
+  template <typename F, typename Part>
+  static void apply_range(F f, size_t n, size_t grain, Part & part);
+
+  // Reduces [0,n), where g(first,last) returns the reduction of a non-empty
+  // subrange. The result is r(init, reduction of all subranges).
+  template <typename V, typename R, typename G>
+  static V reduce_range(size_t n, V init, R r, G g, unordered_reduction);
+
+  template <typename V, typename R, typename G>
+  static V reduce_range(size_t n, V init, R r, G g, deterministic_reduction);
+
+private:
+  static constexpr size_t max_ordered_chunk = 4096;
+
+  // Maps yapl partitioners to TBB partitioners
+  static tbb::auto_partitioner tbb_partitioner(default_partitioner &) { return {}; }
+
+  template <typename Part>
+  static Part & tbb_partitioner(Part & part) { return part; }
+
+  template <typename R>
+  struct ordered_chunk {
+    size_t first;
+    size_t last;
+    std::vector<R> results;
+  };
+
+  // Pipeline computing chunks of results in parallel and retiring them in order
+  template <typename R, typename F, typename C>
+  static void ordered_pipeline(size_t n, F f, C c);
 };
 
-template <class T>
+template <class T, class S>
+constexpr size_t tbb_executor<T,S>::max_ordered_chunk;
+
+template <class T, class S>
+template <class F>
+void tbb_executor<T,S>::apply(F f, T * b, size_t n)
+{
+  default_partitioner part;
+  apply(f, b, n, 0, part);
+}
+
+template <class T, class S>
 template <class F>
-void tbb_executor<T>::apply(F f, T * b, size_t n)
+void tbb_executor<T,S>::apply(F f, T * b, size_t nx, size_t ny, size_t nz)
+{
+  default_partitioner part;
+  apply(f, b, nx, ny, nz, part);
+}
+
+template <class T, class S>
+template <class F, class Part, class>
+void tbb_executor<T,S>::apply(F f, T * b, size_t n, size_t grain, Part & part)
 {
   using namespace tbb;
-  parallel_for(blocked_range<size_t>(0,n),
+  parallel_for(blocked_range<size_t>(0, n, (grain==0) ? 1 : grain),
     [f,b](const blocked_range<size_t> & r) {
       for (auto i=r.begin();i!=r.end();++i) {
         f(b[i]);
       }
-    }
+    },
+    tbb_partitioner(part)
   );
 }
 
-template <class T>
-template <class F>
-void tbb_executor<T>::apply(F f, T * b, size_t nx, size_t ny, size_t nz)
+template <class T, class S>
+template <class F, class Part>
+void tbb_executor<T,S>::apply(F f, T * b, size_t nx, size_t ny, size_t nz, Part & part)
 {
-  for (size_t k=0; k!=nz; ++k) {
-    for (size_t j=0; j!=ny; ++j) {
-      for (size_t i=0; i!=nx; ++i, ++b) {
-        f(*b, cube_index{i,j,k});
+  using namespace tbb;
+  parallel_for(blocked_range3d<size_t>(0,nz,S::z, 0,ny,S::y, 0,nx,S::x),
+    [f,b,nx,ny](const blocked_range3d<size_t> & r) {
+      for (auto k=r.pages().begin(); k!=r.pages().end(); ++k) {
+        for (auto j=r.rows().begin(); j!=r.rows().end(); ++j) {
+          auto row = b + nx * (j + k * ny);
+          for (auto i=r.cols().begin(); i!=r.cols().end(); ++i) {
+            f(row[i], cube_index{i,j,k});
+          }
+        }
       }
-    }
-  }
+    },
+    tbb_partitioner(part)
+  );
 }
 
-template <class T>
+template <class T, class S>
 template <class F>
-void tbb_executor<T>::apply_ordered(F f, T * b, size_t n)
+void tbb_executor<T,S>::apply_ordered(F f, T * b, size_t n)
 {
   auto end = b + n;
   for (;b!=end;++b) {
@@ -92,9 +176,9 @@ void tbb_executor<T>::apply_ordered(F f, T * b, size_t n)
   }
 }
 
-template <class T>
+template <class T, class S>
 template <class F>
-void tbb_executor<T>::apply_ordered(F f, T * b, size_t nx, size_t ny, size_t nz)
+void tbb_executor<T,S>::apply_ordered(F f, T * b, size_t nx, size_t ny, size_t nz)
 {
   for (size_t k=0; k!=nz; ++k) {
     for (size_t j=0; j!=ny; ++j) {
@@ -105,6 +189,148 @@ void tbb_executor<T>::apply_ordered(F f, T * b, size_t nx, size_t ny, size_t nz)
   }
 }
 
+template <class T, class S>
+template <class F, class C>
+void tbb_executor<T,S>::apply_ordered(F f, C c, T * b, size_t n)
+{
+  using result_type = typename std::decay<typename std::result_of<F(T&)>::type>::type;
+  ordered_pipeline<result_type>(n,
+    [f,b](size_t first, size_t last, std::vector<result_type> & v) {
+      for (auto i=first; i!=last; ++i) {
+        v.push_back(f(b[i]));
+      }
+    },
+    c
+  );
+}
+
+template <class T, class S>
+template <class F, class C>
+void tbb_executor<T,S>::apply_ordered(F f, C c, T * b, size_t nx, size_t ny, size_t nz)
+{
+  using result_type = typename std::decay<
+      typename std::result_of<F(T&, const cube_index &)>::type>::type;
+  ordered_pipeline<result_type>(nx * ny * nz,
+    [f,b,nx,ny](size_t first, size_t last, std::vector<result_type> & v) {
+      for_each_index(first, last, nx, ny, [f,b,&v](size_t p, const cube_index & i) {
+        v.push_back(f(b[p], i));
+      });
+    },
+    c
+  );
+}
+
+template <class T, class S>
+template <class R, class F, class C>
+void tbb_executor<T,S>::ordered_pipeline(size_t n, F f, C c)
+{
+  using namespace tbb;
+  using chunk_ptr = ordered_chunk<R> *;
+  if (n==0) return;
+
+  // At most ntokens chunks are alive and they are retired in order,
+  // so chunk slots can be reused round-robin.
+  const size_t ntokens = 4 * this_task_arena::max_concurrency();
+  const size_t chunk = std::max<size_t>(1,
+      std::min<size_t>(max_ordered_chunk, (n + ntokens - 1) / ntokens));
+  std::vector<ordered_chunk<R>> chunks(ntokens);
+  size_t next = 0;
+  size_t seq = 0;
+
+  parallel_pipeline(ntokens,
+    make_filter<void,chunk_ptr>(tbb_filter_mode::serial_in_order,
+      [&](flow_control & fc) -> chunk_ptr {
+        if (next==n) {
+          fc.stop();
+          return nullptr;
+        }
+        auto & ch = chunks[seq++ % ntokens];
+        ch.first = next;
+        next = std::min(n, next + chunk);
+        ch.last = next;
+        return &ch;
+      }
+    ) &
+    make_filter<chunk_ptr,chunk_ptr>(tbb_filter_mode::parallel,
+      [&f](chunk_ptr ch) {
+        f(ch->first, ch->last, ch->results);
+        return ch;
+      }
+    ) &
+    make_filter<chunk_ptr,void>(tbb_filter_mode::serial_in_order,
+      [&c](chunk_ptr ch) {
+        for (auto & r : ch->results) {
+          c(r);
+        }
+        ch->results.clear();
+      }
+    )
+  );
+}
+
+template <class T, class S>
+template <class F, class Part>
+void tbb_executor<T,S>::apply_range(F f, size_t n, size_t grain, Part & part)
+{
+  using namespace tbb;
+  parallel_for(blocked_range<size_t>(0, n, (grain==0) ? 1 : grain),
+    [f](const blocked_range<size_t> & r) {
+      f(r.begin(), r.end());
+    },
+    tbb_partitioner(part)
+  );
+}
+
+template <class T, class S>
+template <class V, class R, class G>
+V tbb_executor<T,S>::reduce_range(size_t n, V init, R r, G g, unordered_reduction)
+{
+  using namespace tbb;
+  // Partial results start empty, so that init is only combined once
+  struct partial {
+    V value;
+    bool valid;
+  };
+  auto res = parallel_reduce(blocked_range<size_t>(0,n), partial{init,false},
+    [&](const blocked_range<size_t> & rg, partial acc) -> partial {
+      V v = g(rg.begin(), rg.end());
+      if (acc.valid) {
+        acc.value = r(acc.value, v);
+      }
+      else {
+        acc.value = v;
+        acc.valid = true;
+      }
+      return acc;
+    },
+    [&](partial lhs, const partial & rhs) -> partial {
+      if (!rhs.valid) return lhs;
+      if (!lhs.valid) return rhs;
+      lhs.value = r(lhs.value, rhs.value);
+      return lhs;
+    }
+  );
+  return res.valid ? r(init, res.value) : init;
+}
+
+template <class T, class S>
+template <class V, class R, class G>
+V tbb_executor<T,S>::reduce_range(size_t n, V init, R r, G g, deterministic_reduction)
+{
+  using namespace tbb;
+  const size_t chunk = deterministic_reduction::chunk_size();
+  const size_t nchunks = (n + chunk - 1) / chunk;
+  std::vector<partial_result<V>> partials(nchunks, partial_result<V>{init});
+  parallel_for(blocked_range<size_t>(0,nchunks),
+    [&](const blocked_range<size_t> & rg) {
+      for (auto c=rg.begin(); c!=rg.end(); ++c) {
+        partials[c].value = g(c * chunk, std::min(n, (c + 1) * chunk));
+      }
+    }
+  );
+  return fold_partials(init, r, partials);
+}
+
 }
 
 #endif
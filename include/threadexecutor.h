@@ -0,0 +1,536 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_THREAD_EXECUTOR_H
+#define YAPL_THREAD_EXECUTOR_H
+
+#include "cube_index.h"
+#include "tile_shape.h"
+#include "partitioner.h"
+#include "reduction.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <cstdlib>
+#include <cstddef>
+
+namespace yapl {
+
+// Persistent pool of std::thread workers. Every worker owns a deque of jobs.
+// A worker pops jobs from the back of its own deque and, when empty, steals
+// from the front of the other deques. The thread calling parallel_for also
+// executes jobs while it waits, so nested calls from a worker do not block.
+// If a job throws, the remaining jobs of its call are skipped and the first
+// exception is rethrown to the caller once every job has finished.
+//
+// The number of threads (including the caller) is taken from the
+// YAPL_NUM_THREADS environment variable or the hardware concurrency.
+class thread_pool {
+public:
+  static thread_pool & instance();
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool & operator=(const thread_pool &) = delete;
+
+  ~thread_pool();
+
+  size_t concurrency() const { return queues_.size() + 1; }
+
+  // Calls f(first,last) over subranges of [0,n) with at least grain elements
+  template <class F>
+  void parallel_for(size_t n, size_t grain, F f);
+
+  // Calls f(first,last,v) in parallel, where f appends to v the results of
+  // range [first,last), and passes every result to c in index order.
+  // Chunks are retired as soon as all previous chunks have been retired.
+  template <class R, class F, class C>
+  void parallel_ordered(size_t n, F f, C c);
+
+private:
+  // State shared by the jobs of one parallel_for call
+  struct job_group {
+    std::atomic<size_t> pending;
+    std::atomic<bool> failed;
+    std::exception_ptr error;
+  };
+
+  struct job {
+    void (*run)(void *, size_t, size_t);
+    void * body;
+    size_t first;
+    size_t last;
+    job_group * group;
+  };
+
+  struct job_queue {
+    std::mutex mtx_;
+    std::deque<job> jobs_;
+  };
+
+  static constexpr size_t no_worker = std::numeric_limits<size_t>::max();
+  static constexpr size_t jobs_per_thread = 4;
+  static constexpr size_t max_ordered_chunk = 4096;
+
+  explicit thread_pool(size_t nthreads);
+
+  static size_t default_concurrency();
+  static size_t & current_worker();
+
+  template <class F>
+  static void run_body(void * body, size_t first, size_t last) {
+    (*static_cast<F*>(body))(first, last);
+  }
+
+  void push(size_t q, const job & j);
+  bool find_job(size_t self, job & j);
+  void execute(const job & j);
+  void worker_loop(size_t id);
+
+private:
+  std::vector<std::unique_ptr<job_queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::mutex wake_mtx_;
+  std::condition_variable wake_;
+  std::atomic<size_t> queued_;
+  bool stop_;
+};
+
+inline thread_pool & thread_pool::instance()
+{
+  static thread_pool pool{default_concurrency()};
+  return pool;
+}
+
+inline thread_pool::thread_pool(size_t nthreads)
+:
+queues_{},
+workers_{},
+wake_mtx_{},
+wake_{},
+queued_{0},
+stop_{false}
+{
+  for (size_t i=1; i<nthreads; ++i) {
+    queues_.emplace_back(new job_queue);
+  }
+  for (size_t i=0; i!=queues_.size(); ++i) {
+    workers_.emplace_back([this,i] { worker_loop(i); });
+  }
+}
+
+inline thread_pool::~thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock{wake_mtx_};
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto & w : workers_) {
+    w.join();
+  }
+}
+
+inline size_t thread_pool::default_concurrency()
+{
+  const char * env = std::getenv("YAPL_NUM_THREADS");
+  size_t n = (env != nullptr) ? std::strtoul(env, nullptr, 10) : std::thread::hardware_concurrency();
+  return (n==0) ? 1 : n;
+}
+
+inline size_t & thread_pool::current_worker()
+{
+  static thread_local size_t id = no_worker;
+  return id;
+}
+
+template <class F>
+void thread_pool::parallel_for(size_t n, size_t grain, F f)
+{
+  if (n==0) return;
+  grain = std::max<size_t>(grain, 1);
+  const size_t nchunks = std::min((n + grain - 1) / grain, concurrency() * jobs_per_thread);
+  if (nchunks <= 1 || queues_.empty()) {
+    f(0, n);
+    return;
+  }
+
+  job_group group;
+  group.pending.store(nchunks, std::memory_order_relaxed);
+  group.failed.store(false, std::memory_order_relaxed);
+  const size_t self = current_worker();
+  for (size_t c=0; c!=nchunks; ++c) {
+    job j{&run_body<F>, &f, n * c / nchunks, n * (c+1) / nchunks, &group};
+    push((self == no_worker) ? c % queues_.size() : self, j);
+  }
+  {
+    std::lock_guard<std::mutex> lock{wake_mtx_};
+  }
+  wake_.notify_all();
+
+  // Jobs refer to f and group, so every job must finish before returning
+  while (group.pending.load(std::memory_order_acquire) != 0) {
+    job j;
+    if (find_job(self, j)) {
+      execute(j);
+    }
+    else {
+      std::this_thread::yield();
+    }
+  }
+  if (group.error) {
+    std::rethrow_exception(group.error);
+  }
+}
+
+template <class R, class F, class C>
+void thread_pool::parallel_ordered(size_t n, F f, C c)
+{
+  if (n==0) return;
+  const size_t window = concurrency() * jobs_per_thread;
+  const size_t max_chunk = max_ordered_chunk;
+  const size_t chunk = std::max<size_t>(1, std::min(max_chunk, (n + window - 1) / window));
+
+  std::vector<std::vector<R>> results(window);
+  std::unique_ptr<std::atomic<bool>[]> done{new std::atomic<bool>[window]};
+  std::atomic<size_t> next{0};
+  std::mutex retire_mtx;
+
+  auto retire = [&](size_t nchunks) {
+    size_t i = next.load(std::memory_order_relaxed);
+    while (i!=nchunks && done[i].load()) {
+      for (auto & r : results[i]) {
+        c(r);
+      }
+      results[i].clear();
+      next.store(++i, std::memory_order_relaxed);
+    }
+  };
+
+  for (size_t wfirst=0; wfirst<n; wfirst += window * chunk) {
+    const size_t wlast = std::min(n, wfirst + window * chunk);
+    const size_t nchunks = (wlast - wfirst + chunk - 1) / chunk;
+    for (size_t i=0; i!=nchunks; ++i) {
+      done[i].store(false, std::memory_order_relaxed);
+    }
+    next.store(0, std::memory_order_relaxed);
+
+    parallel_for(nchunks, 1, [&](size_t first, size_t last) {
+      for (size_t i=first; i!=last; ++i) {
+        const size_t efirst = wfirst + i * chunk;
+        f(efirst, std::min(wlast, efirst + chunk), results[i]);
+        done[i].store(true);
+        // Only one thread retires at a time. The check after unlocking
+        // avoids leaving a completed chunk behind when another thread
+        // finished it while we were holding the lock.
+        while (retire_mtx.try_lock()) {
+          retire(nchunks);
+          retire_mtx.unlock();
+          const size_t pos = next.load(std::memory_order_relaxed);
+          if (pos==nchunks || !done[pos].load()) break;
+        }
+      }
+    });
+
+    std::lock_guard<std::mutex> lock{retire_mtx};
+    retire(nchunks);
+  }
+}
+
+inline void thread_pool::push(size_t q, const job & j)
+{
+  {
+    std::lock_guard<std::mutex> lock{queues_[q]->mtx_};
+    queues_[q]->jobs_.push_back(j);
+  }
+  queued_.fetch_add(1, std::memory_order_release);
+}
+
+inline bool thread_pool::find_job(size_t self, job & j)
+{
+  if (queued_.load(std::memory_order_acquire) == 0) return false;
+
+  if (self != no_worker) {
+    auto & q = *queues_[self];
+    std::lock_guard<std::mutex> lock{q.mtx_};
+    if (!q.jobs_.empty()) {
+      j = q.jobs_.back();
+      q.jobs_.pop_back();
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  const size_t nqueues = queues_.size();
+  const size_t start = (self == no_worker) ? 0 : self + 1;
+  for (size_t i=0; i!=nqueues; ++i) {
+    auto & q = *queues_[(start + i) % nqueues];
+    std::lock_guard<std::mutex> lock{q.mtx_};
+    if (!q.jobs_.empty()) {
+      j = q.jobs_.front();
+      q.jobs_.pop_front();
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void thread_pool::execute(const job & j)
+{
+  job_group & g = *j.group;
+  if (!g.failed.load(std::memory_order_relaxed)) {
+    try {
+      j.run(j.body, j.first, j.last);
+    }
+    catch (...) {
+      bool expected = false;
+      if (g.failed.compare_exchange_strong(expected, true)) {
+        g.error = std::current_exception();
+      }
+    }
+  }
+  g.pending.fetch_sub(1, std::memory_order_release);
+}
+
+inline void thread_pool::worker_loop(size_t id)
+{
+  current_worker() = id;
+  for (;;) {
+    job j;
+    if (find_job(id, j)) {
+      execute(j);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock{wake_mtx_};
+    wake_.wait(lock, [this] { return stop_ || queued_.load() != 0; });
+    if (stop_ && queued_.load() == 0) return;
+  }
+}
+
+// Executor running on the shared thread_pool.
+// Indexed sweeps are split in 3D tiles of shape S (see tile_shape.h)
+template <class T, class S = default_tile_shape>
+class thread_executor {
+public:
+  using mutex_type = std::mutex;
+
+  template <typename F>
+  static void apply(F f, T * b, size_t n);
+
+  template <typename F>
+  static void apply(F f, T * b, size_t nx, size_t ny, size_t nz);
+
+  template <typename F, typename Part, typename = requires_partitioner<Part>>
+  static void apply(F f, T * b, size_t n, size_t grain, Part & part);
+
+  template <typename F, typename Part>
+  static void apply(F f, T * b, size_t nx, size_t ny, size_t nz, Part & part);
+
+  template <typename F>
+  static void apply_ordered(F f, T * b, size_t n);
+
+  template <typename F>
+  static void apply_ordered(F f, T * b, size_t nx, size_t ny, size_t nz);
+
+  template <typename F, typename C>
+  static void apply_ordered(F f, C c, T * b, size_t n);
+
+  template <typename F, typename C>
+  static void apply_ordered(F f, C c, T * b, size_t nx, size_t ny, size_t nz);
+
+  // Calls f(first,last) on non-empty subranges covering [0,n)
+  template <typename F, typename Part>
+  static void apply_range(F f, size_t n, size_t grain, Part & part);
+
+  // Reduces [0,n), where g(first,last) returns the reduction of a non-empty
+  // subrange. The result is r(init, reduction of all subranges).
+  template <typename V, typename R, typename G>
+  static V reduce_range(size_t n, V init, R r, G g, unordered_reduction);
+
+  template <typename V, typename R, typename G>
+  static V reduce_range(size_t n, V init, R r, G g, deterministic_reduction);
+
+private:
+  template <typename V, typename R, typename G>
+  static V chunked_reduce(size_t n, size_t chunk, V init, R r, G g);
+};
+
+template <class T, class S>
+template <class F>
+void thread_executor<T,S>::apply(F f, T * b, size_t n)
+{
+  default_partitioner part;
+  apply(f, b, n, 0, part);
+}
+
+template <class T, class S>
+template <class F>
+void thread_executor<T,S>::apply(F f, T * b, size_t nx, size_t ny, size_t nz)
+{
+  default_partitioner part;
+  apply(f, b, nx, ny, nz, part);
+}
+
+// Partitioners are ignored by this executor. Chunks go to whichever worker
+// takes or steals them first.
+template <class T, class S>
+template <class F, class Part, class>
+void thread_executor<T,S>::apply(F f, T * b, size_t n, size_t grain, Part &)
+{
+  thread_pool::instance().parallel_for(n, grain,
+    [f,b](size_t first, size_t last) {
+      for (auto i=first; i!=last; ++i) {
+        f(b[i]);
+      }
+    }
+  );
+}
+
+template <class T, class S>
+template <class F, class Part>
+void thread_executor<T,S>::apply(F f, T * b, size_t nx, size_t ny, size_t nz, Part &)
+{
+  const size_t tx = (nx + S::x - 1) / S::x;
+  const size_t ty = (ny + S::y - 1) / S::y;
+  const size_t tz = (nz + S::z - 1) / S::z;
+  thread_pool::instance().parallel_for(tx * ty * tz, 1,
+    [f,b,nx,ny,nz,tx,ty](size_t first, size_t last) {
+      for (auto t=first; t!=last; ++t) {
+        const size_t x0 = (t % tx) * S::x;
+        const size_t y0 = ((t / tx) % ty) * S::y;
+        const size_t z0 = (t / (tx * ty)) * S::z;
+        const size_t x1 = std::min(x0 + S::x, nx);
+        const size_t y1 = std::min(y0 + S::y, ny);
+        const size_t z1 = std::min(z0 + S::z, nz);
+        for (size_t k=z0; k!=z1; ++k) {
+          for (size_t j=y0; j!=y1; ++j) {
+            auto row = b + nx * (j + k * ny);
+            for (size_t i=x0; i!=x1; ++i) {
+              f(row[i], cube_index{i,j,k});
+            }
+          }
+        }
+      }
+    }
+  );
+}
+
+template <class T, class S>
+template <class F>
+void thread_executor<T,S>::apply_ordered(F f, T * b, size_t n)
+{
+  auto end = b + n;
+  for (;b!=end;++b) {
+    f(*b);
+  }
+}
+
+template <class T, class S>
+template <class F>
+void thread_executor<T,S>::apply_ordered(F f, T * b, size_t nx, size_t ny, size_t nz)
+{
+  for (size_t k=0; k!=nz; ++k) {
+    for (size_t j=0; j!=ny; ++j) {
+      for (size_t i=0; i!=nx; ++i, ++b) {
+        f(*b, cube_index{i,j,k});
+      }
+    }
+  }
+}
+
+template <class T, class S>
+template <class F, class C>
+void thread_executor<T,S>::apply_ordered(F f, C c, T * b, size_t n)
+{
+  using result_type = typename std::decay<typename std::result_of<F(T&)>::type>::type;
+  thread_pool::instance().parallel_ordered<result_type>(n,
+    [f,b](size_t first, size_t last, std::vector<result_type> & v) {
+      for (auto i=first; i!=last; ++i) {
+        v.push_back(f(b[i]));
+      }
+    },
+    c
+  );
+}
+
+template <class T, class S>
+template <class F, class C>
+void thread_executor<T,S>::apply_ordered(F f, C c, T * b, size_t nx, size_t ny, size_t nz)
+{
+  using result_type = typename std::decay<
+      typename std::result_of<F(T&, const cube_index &)>::type>::type;
+  thread_pool::instance().parallel_ordered<result_type>(nx * ny * nz,
+    [f,b,nx,ny](size_t first, size_t last, std::vector<result_type> & v) {
+      for_each_index(first, last, nx, ny, [f,b,&v](size_t p, const cube_index & i) {
+        v.push_back(f(b[p], i));
+      });
+    },
+    c
+  );
+}
+
+template <class T, class S>
+template <class F, class Part>
+void thread_executor<T,S>::apply_range(F f, size_t n, size_t grain, Part &)
+{
+  thread_pool::instance().parallel_for(n, grain, f);
+}
+
+template <class T, class S>
+template <class V, class R, class G>
+V thread_executor<T,S>::reduce_range(size_t n, V init, R r, G g, unordered_reduction)
+{
+  const size_t nchunks = 4 * thread_pool::instance().concurrency();
+  return chunked_reduce(n, std::max<size_t>(1, (n + nchunks - 1) / nchunks), init, r, g);
+}
+
+template <class T, class S>
+template <class V, class R, class G>
+V thread_executor<T,S>::reduce_range(size_t n, V init, R r, G g, deterministic_reduction)
+{
+  return chunked_reduce(n, deterministic_reduction::chunk_size(), init, r, g);
+}
+
+template <class T, class S>
+template <class V, class R, class G>
+V thread_executor<T,S>::chunked_reduce(size_t n, size_t chunk, V init, R r, G g)
+{
+  const size_t nchunks = (n + chunk - 1) / chunk;
+  std::vector<partial_result<V>> partials(nchunks, partial_result<V>{init});
+  thread_pool::instance().parallel_for(nchunks, 1, [&](size_t first, size_t last) {
+    for (auto c=first; c!=last; ++c) {
+      partials[c].value = g(c * chunk, std::min(n, (c + 1) * chunk));
+    }
+  });
+  return fold_partials(init, r, partials);
+}
+
+}
+
+#endif
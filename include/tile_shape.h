@@ -0,0 +1,52 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#ifndef YAPL_TILE_SHAPE_H
+#define YAPL_TILE_SHAPE_H
+
+#include <cstddef>
+
+namespace yapl {
+
+// Shape of the 3D tiles used by parallel executors when splitting an
+// indexed (nx,ny,nz) iteration space. Tiles are traversed in row-major
+// order, so X should be the largest extent to keep inner loops contiguous.
+template <size_t X, size_t Y, size_t Z>
+struct tile_shape {
+  static constexpr size_t x = X;
+  static constexpr size_t y = Y;
+  static constexpr size_t z = Z;
+};
+
+template <size_t X, size_t Y, size_t Z>
+constexpr size_t tile_shape<X,Y,Z>::x;
+
+template <size_t X, size_t Y, size_t Z>
+constexpr size_t tile_shape<X,Y,Z>::y;
+
+template <size_t X, size_t Y, size_t Z>
+constexpr size_t tile_shape<X,Y,Z>::z;
+
+using default_tile_shape = tile_shape<64,4,4>;
+
+}
+
+#endif
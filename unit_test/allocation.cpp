@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#include "block.h"
+#include "cube.h"
+#include "policy.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+using namespace yapl;
+using namespace std;
+
+template <typename A>
+class allocation_test : public ::testing::Test {
+public:
+  using block_type = block<double, policy<sequential_executor<double>, default_partitioner, 0, A>>;
+};
+
+typedef ::testing::Types<
+  new_allocation,
+  aligned_allocation<32>,
+  cache_aligned_allocation,
+  huge_page_allocation
+> my_test_types;
+TYPED_TEST_CASE(allocation_test, my_test_types);
+
+TYPED_TEST(allocation_test, initialized)
+{
+  typename TestFixture::block_type b(1000);
+  for (int i=0; i<1000; ++i) {
+    ASSERT_EQ(0.0, b[i]);
+  }
+}
+
+TYPED_TEST(allocation_test, apply)
+{
+  typename TestFixture::block_type b(1000);
+  b.apply([](double & x) { x=2; }, 1000);
+  for (int i=0; i<1000; ++i) {
+    ASSERT_EQ(2.0, b[i]);
+  }
+}
+
+TYPED_TEST(allocation_test, move)
+{
+  typename TestFixture::block_type b1(4);
+  typename TestFixture::block_type b2(7);
+  b1[0]=1.0;
+  b2[0]=-1.0;
+  swap(b1,b2);
+  EXPECT_EQ(-1.0, b1[0]);
+  EXPECT_EQ(1.0, b2[0]);
+}
+
+TEST(allocation, cache_aligned)
+{
+  using block_type = block<float, policy<sequential_executor<float>, default_partitioner, 0, cache_aligned_allocation>>;
+  block_type b(100);
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(&b[0]) % 64);
+}
+
+TEST(allocation, huge_page_aligned)
+{
+  using block_type = block<float, policy<sequential_executor<float>, default_partitioner, 0, huge_page_allocation>>;
+  block_type b(100);
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(&b[0]) % huge_page_allocation::page_size());
+}
+
+namespace {
+
+struct counted {
+  static int alive;
+  counted() { ++alive; }
+  ~counted() { --alive; }
+};
+
+int counted::alive = 0;
+
+}
+
+TEST(allocation, destroys_elements)
+{
+  {
+    block<counted, policy<sequential_executor<counted>, default_partitioner, 0, cache_aligned_allocation>> b(10);
+    EXPECT_EQ(10, counted::alive);
+  }
+  EXPECT_EQ(0, counted::alive);
+}
+
+TEST(allocation, mapped_file)
+{
+  using policy_type = policy<sequential_executor<double>, default_partitioner, 0, mapped_file_allocation>;
+  using cube_type = cube<double, policy_type>;
+  const std::string path = "yapl_mapped_file_test_" + std::to_string(::getpid()) + ".dat";
+  std::remove(path.c_str());
+  {
+    cube_type c{3,4,5, mapped_file_allocation{path}};
+    c.all().apply([](double & x) { EXPECT_EQ(0.0, x); });
+    c.all().apply_indexed([](double & x, const cube_index & i) {
+      x = i.get<0>() + 10 * i.get<1>() + 100 * i.get<2>();
+    });
+    c.template plane<2>(4).apply([](double & x) { x = -1; });
+    c.get_allocation().flush();
+  }
+  {
+    cube_type c{3,4,5, mapped_file_allocation{path}};
+    for (size_t i=0; i<c.size_x(); ++i) {
+      for (size_t j=0;j<c.size_y(); ++j) {
+        for (size_t k=0;k<c.size_z(); ++k) {
+          double expected = (k==4) ? -1.0 : double(i + 10*j + 100*k);
+          ASSERT_EQ(expected, c(i,j,k));
+        }
+      }
+    }
+    auto plus = [](double x, double y) { return x+y; };
+    EXPECT_EQ(-12.0, c.template plane<2>(4).reduce(0.0, plus));
+  }
+  std::remove(path.c_str());
+}
@@ -21,7 +21,9 @@ SOFTWARE.
  */
 #include "block.h"
 #include "policy.h"
+#include "threadexecutor.h"
 #include <gtest/gtest.h>
+#include <stdexcept>
 
 using namespace yapl;
 using namespace std;
@@ -95,3 +97,64 @@ TYPED_TEST(block_test, swap)
   ASSERT_EQ(-1.0, b1[0]);
   ASSERT_EQ(1.0, b2[0]);
 }
+
+TYPED_TEST(block_test, first_touch_init)
+{
+  typename TestFixture::block_type b(100, first_touch_init);
+  for (int i=0; i<100; ++i) {
+    ASSERT_EQ(TypeParam{}, b[i]);
+  }
+}
+
+TYPED_TEST(block_test, no_init)
+{
+  typename TestFixture::block_type b(100, no_init);
+  b.apply([](TypeParam & x) { x=1; }, 100);
+  for (int i=0; i<100; ++i) {
+    ASSERT_EQ(TypeParam{1}, b[i]);
+  }
+}
+
+namespace {
+
+// Counts live instances, and throws when the instance numbered fail_at is built
+struct counted {
+  static int live;
+  static int built;
+  static int fail_at;
+
+  counted() {
+    if (built++ == fail_at) throw std::runtime_error{"counted"};
+    ++live;
+  }
+  ~counted() { --live; }
+};
+
+int counted::live = 0;
+int counted::built = 0;
+int counted::fail_at = -1;
+
+template <typename B, typename ... A>
+void check_rollback(A ... a)
+{
+  counted::live = 0;
+  counted::built = 0;
+  counted::fail_at = 37;
+  EXPECT_THROW(B(100, a...), std::runtime_error);
+  EXPECT_EQ(0, counted::live);
+
+  counted::fail_at = -1;
+  {
+    B b(100, a...);
+    EXPECT_EQ(100, counted::live);
+  }
+  EXPECT_EQ(0, counted::live);
+}
+
+}
+
+TEST(block_exception_test, constructor_rollback)
+{
+  check_rollback<block<counted, default_policy<counted>>>();
+  check_rollback<block<counted, policy<thread_executor<counted>>>>(first_touch_init);
+}
@@ -21,7 +21,14 @@ SOFTWARE.
  */
 #include "block_list.h"
 #include "policy.h"
+#include "threadexecutor.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
 
 using namespace yapl;
 using namespace std;
@@ -106,13 +113,330 @@ TYPED_TEST(block_list_test, apply_cartesian_unique)
 
 
   EXPECT_EQ(49*50/2, v.size());
-
+  std::sort(v.begin(), v.end());
   auto itv = v.begin();
-  auto itw = w.begin();
   for (int i=0;i<50; ++i) {
     for (int j=0;j<i; ++j) {
       EXPECT_EQ(make_pair(i,j), *itv++);
     }
-    EXPECT_EQ(i, *itw++);
   }
+
+  ASSERT_EQ(50u, w.size());
+  for (int i=0;i<50; ++i) {
+    EXPECT_EQ(i, w[i]);
+  }
+}
+
+TYPED_TEST(block_list_test, full_chunks)
+{
+  typename TestFixture::block_list_type bl;
+  for (int i=0;i<32;i++) {
+    bl.add(i);
+  }
+
+  int n = 0;
+  bl.apply([&n](int x) {
+    EXPECT_EQ(n, x);
+    n++;
+  });
+  EXPECT_EQ(32, n);
+  EXPECT_EQ(31, bl.at(31));
+}
+
+TYPED_TEST(block_list_test, random_access)
+{
+  typename TestFixture::block_list_type bl;
+  for (int i=0;i<1000;i++) {
+    bl.add(3*i);
+  }
+
+  const auto & cbl = bl;
+  for (int i=999;i>=0;i-=7) {
+    EXPECT_EQ(3*i, cbl.at(i));
+  }
+  bl.at(500) = -1;
+  EXPECT_EQ(-1, cbl.at(500));
+}
+
+TYPED_TEST(block_list_test, clear_and_reuse)
+{
+  typename TestFixture::block_list_type bl;
+  for (int i=0;i<40;i++) {
+    bl.add(i);
+  }
+  bl.clear();
+  EXPECT_EQ(0, bl.size());
+  for (int i=0;i<20;i++) {
+    bl.add(2*i);
+  }
+  EXPECT_EQ(20, bl.size());
+  EXPECT_EQ(38, bl.at(19));
+}
+
+TYPED_TEST(block_list_test, aligned_chunks)
+{
+  typename TestFixture::block_list_type bl;
+  for (int i=0;i<40;i++) {
+    bl.add(i);
+  }
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(&bl.at(0)) % 64);
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(&bl.at(32)) % 64);
+  EXPECT_EQ(&bl.at(0) + 15, &bl.at(15));
+}
+
+TEST(block_list_capacity_test, small_chunks)
+{
+  block_list<int, default_policy<int>, 3> bl;
+  for (int i=0;i<10;i++) {
+    bl.add(i);
+  }
+  EXPECT_EQ(10u, bl.size());
+  for (int i=0;i<10;i++) {
+    EXPECT_EQ(i, bl.at(i));
+  }
+
+  int pairs = 0;
+  int n = 0;
+  bl.apply_cartesian_unique(
+    [&pairs](int x, int y) { EXPECT_LT(y, x); pairs++; },
+    [&n](int) { n++; });
+  EXPECT_EQ(45, pairs);
+  EXPECT_EQ(10, n);
+}
+
+TEST(block_list_capacity_test, single_element_chunks)
+{
+  block_list<int, default_policy<int>, 1> bl;
+  for (int i=0;i<5;i++) {
+    bl.add(i);
+  }
+  int sum = 0;
+  bl.apply([&sum](int x) { sum += x; });
+  EXPECT_EQ(10, sum);
+}
+
+TEST(block_list_capacity_test, destroys_elements)
+{
+  auto p = std::make_shared<int>(0);
+  {
+    block_list<std::shared_ptr<int>, default_policy<std::shared_ptr<int>>, 4> bl;
+    for (int i=0;i<10;i++) {
+      bl.add(p);
+    }
+    EXPECT_EQ(11, p.use_count());
+    bl.clear();
+    EXPECT_EQ(1, p.use_count());
+    bl.add(p);
+    EXPECT_EQ(2, p.use_count());
+  }
+  EXPECT_EQ(1, p.use_count());
+}
+
+template <typename P>
+class block_list_parallel_test : public ::testing::Test {
+public:
+  using block_list_type = block_list<long, P, 8>;
+};
+
+typedef ::testing::Types<
+  policy<sequential_executor<long>>,
+  policy<thread_executor<long>>,
+  policy<thread_executor<long>, default_partitioner, 20>
+> parallel_test_types;
+TYPED_TEST_CASE(block_list_parallel_test, parallel_test_types);
+
+TYPED_TEST(block_list_parallel_test, apply)
+{
+  typename TestFixture::block_list_type bl;
+  const long n = 10007;
+  for (long i=0;i<n;i++) {
+    bl.add(i);
+  }
+  bl.apply([](long & x) { x *= 2; });
+  for (long i=0;i<n;i++) {
+    EXPECT_EQ(2*i, bl.at(i));
+  }
+}
+
+TYPED_TEST(block_list_parallel_test, apply_const)
+{
+  typename TestFixture::block_list_type bl;
+  const long n = 10007;
+  for (long i=0;i<n;i++) {
+    bl.add(i);
+  }
+  std::atomic<long> sum{0};
+  std::atomic<long> count{0};
+  const auto & cbl = bl;
+  cbl.apply([&sum,&count](long x) { sum += x; ++count; });
+  EXPECT_EQ(n, count.load());
+  EXPECT_EQ(n*(n-1)/2, sum.load());
+}
+
+TYPED_TEST(block_list_parallel_test, apply_empty)
+{
+  typename TestFixture::block_list_type bl;
+  int n = 0;
+  bl.apply([&n](long) { ++n; });
+  EXPECT_EQ(0, n);
+}
+
+TYPED_TEST(block_list_parallel_test, apply_cartesian_unique)
+{
+  for (long n : {0, 1, 7, 8, 9, 64, 1001}) {
+    typename TestFixture::block_list_type bl;
+    for (long i=0;i<n;i++) {
+      bl.add(0);
+    }
+    // Conflicting tiles would race on the counters
+    bl.apply_cartesian_unique(
+      [](long & x, long & y) { ++x; ++y; },
+      [](long & x) { x += 1000; });
+    for (long i=0;i<n;i++) {
+      EXPECT_EQ(n-1+1000, bl.at(i)) << n;
+    }
+  }
+}
+
+TYPED_TEST(block_list_parallel_test, apply_cartesian_unique_addresses)
+{
+  typename TestFixture::block_list_type bl;
+  const long n = 100;
+  for (long i=0;i<n;i++) {
+    bl.add(i);
+  }
+  // Both elements of a pair are passed as the list elements themselves
+  const auto & cbl = bl;
+  std::atomic<long> wrong{0};
+  bl.apply_cartesian_unique(
+    [&cbl,&wrong](long & x, long & y) {
+      if (&x != &cbl.at(x) || &y != &cbl.at(y)) ++wrong;
+    },
+    [](long &) {});
+  EXPECT_EQ(0, wrong.load());
+}
+
+TYPED_TEST(block_list_parallel_test, apply_cartesian_unique_order)
+{
+  typename TestFixture::block_list_type bl;
+  const long n = 300;
+  for (long i=0;i<n;i++) {
+    bl.add(i);
+  }
+  std::atomic<long> pairs{0};
+  std::atomic<long> wrong{0};
+  std::atomic<long> sum{0};
+  bl.apply_cartesian_unique(
+    [&pairs,&wrong,&sum](long & x, long & y) {
+      ++pairs;
+      if (y >= x) ++wrong;
+      sum += x * n + y;
+    },
+    [](long &) {});
+  long expected = 0;
+  for (long i=0;i<n;i++) {
+    for (long j=0;j<i;j++) {
+      expected += i * n + j;
+    }
+  }
+  EXPECT_EQ(n*(n-1)/2, pairs.load());
+  EXPECT_EQ(0, wrong.load());
+  EXPECT_EQ(expected, sum.load());
+}
+
+namespace {
+
+// Adds [0,n) from several threads through concurrent_add
+template <typename L>
+void concurrent_fill(L & bl, long n, int nthreads)
+{
+  std::vector<std::thread> producers;
+  for (int t=0; t<nthreads; ++t) {
+    producers.emplace_back([&bl,n,t,nthreads] {
+      for (long i=t; i<n; i+=nthreads) {
+        bl.concurrent_add(i);
+      }
+    });
+  }
+  for (auto & p : producers) {
+    p.join();
+  }
+}
+
+// Checks that bl holds each value of [0,n) exactly once
+template <typename L>
+void check_permutation(const L & bl, long n)
+{
+  ASSERT_EQ(size_t(n), bl.size());
+  std::vector<long> v;
+  for (long i=0; i<n; ++i) {
+    v.push_back(bl.at(i));
+  }
+  std::sort(v.begin(), v.end());
+  for (long i=0; i<n; ++i) {
+    EXPECT_EQ(i, v[i]);
+  }
+}
+
+}
+
+TEST(block_list_concurrent_test, concurrent_add)
+{
+  block_list<long, default_policy<long>, 16> bl;
+  concurrent_fill(bl, 100000, 4);
+  check_permutation(bl, 100000);
+}
+
+TEST(block_list_concurrent_test, small_chunks)
+{
+  // Every add allocates a chunk, and many allocate a directory segment
+  block_list<long, default_policy<long>, 1> bl;
+  concurrent_fill(bl, 20000, 8);
+  check_permutation(bl, 20000);
+}
+
+TEST(block_list_concurrent_test, then_sequential)
+{
+  block_list<long, default_policy<long>, 4> bl;
+  concurrent_fill(bl, 1001, 3);
+  for (long i=1001; i<1100; ++i) {
+    bl.add(i);
+  }
+  check_permutation(bl, 1100);
+
+  bl.clear();
+  EXPECT_EQ(0u, bl.size());
+  concurrent_fill(bl, 500, 5);
+  check_permutation(bl, 500);
+}
+
+TEST(block_list_concurrent_test, parallel_apply)
+{
+  block_list<long, policy<thread_executor<long>>, 8> bl;
+  concurrent_fill(bl, 50000, 4);
+  std::atomic<long> sum{0};
+  bl.apply([&sum](long x) { sum += x; });
+  EXPECT_EQ(50000L*49999/2, sum.load());
+}
+
+TEST(block_list_concurrent_test, destroys_elements)
+{
+  auto p = std::make_shared<int>(0);
+  {
+    block_list<std::shared_ptr<int>, default_policy<std::shared_ptr<int>>, 4> bl;
+    std::vector<std::thread> producers;
+    for (int t=0; t<4; ++t) {
+      producers.emplace_back([&bl,&p] {
+        for (int i=0; i<100; ++i) {
+          bl.concurrent_add(p);
+        }
+      });
+    }
+    for (auto & t : producers) {
+      t.join();
+    }
+    EXPECT_EQ(400u, bl.size());
+    EXPECT_EQ(401, p.use_count());
+  }
+  EXPECT_EQ(1, p.use_count());
 }
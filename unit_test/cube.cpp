@@ -21,7 +21,13 @@ SOFTWARE.
  */
 #include "cube.h"
 #include "policy.h"
+#include "threadexecutor.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
 
 using namespace yapl;
 using namespace std;
@@ -60,6 +66,22 @@ TYPED_TEST(cube_test, get_sizes_index)
   EXPECT_EQ(5, c.template size<2>());
 }
 
+TYPED_TEST(cube_test, first_touch_init)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{3,4,5, first_touch_init};
+  EXPECT_EQ((cube_index{3,4,5}), c.size());
+  EXPECT_FLOAT_EQ(0.0, c(2,3,4));
+}
+
+TYPED_TEST(cube_test, no_init)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{cube_index{3,4,5}, no_init};
+  c.all().apply([](TypeParam & x) { x = 1.0; });
+  EXPECT_FLOAT_EQ(1.0, c(2,3,4));
+}
+
 TYPED_TEST(cube_test, member_swap)
 {
   using cube = typename TestFixture::cube_type;
@@ -478,3 +500,231 @@ TYPED_TEST(cube_test, fill_neighbours_unique_indexed)
 }
 
 
+
+TYPED_TEST(cube_test, periodic_default)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,7,9};
+  EXPECT_FALSE(c.template periodic<0>());
+  EXPECT_FALSE(c.template periodic<1>());
+  EXPECT_FALSE(c.template periodic<2>());
+  c.set_periodic(true, false, true);
+  EXPECT_TRUE(c.template periodic<0>());
+  EXPECT_FALSE(c.template periodic<1>());
+  EXPECT_TRUE(c.template periodic<2>());
+}
+
+TYPED_TEST(cube_test, periodic_all_neighbours_corner)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,7,9};
+  c.set_periodic(true, true, true);
+  std::vector<TypeParam*> v;
+  c.for_all_neighbours({0,0,0}, [&v](TypeParam & x) { v.push_back(&x); });
+  ASSERT_EQ(26u, v.size());
+  EXPECT_EQ(&c(4,6,8), v.front());
+  EXPECT_EQ(&c(1,1,1), v.back());
+  EXPECT_NE(v.end(), std::find(v.begin(), v.end(), &c(4,0,0)));
+  EXPECT_NE(v.end(), std::find(v.begin(), v.end(), &c(0,6,1)));
+}
+
+TYPED_TEST(cube_test, periodic_single_axis)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,7,9};
+  c.set_periodic(true, false, false);
+  int n = 0;
+  c.for_all_neighbours({0,0,0}, [&n](TypeParam &) { ++n; });
+  EXPECT_EQ(3*2*2-1, n);
+}
+
+TYPED_TEST(cube_test, periodic_shifts)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,7,9};
+  c.set_periodic(true, true, true);
+  TypeParam * n[13];
+  cube_shift s[13] = {
+    {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0},
+    {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}
+  };
+  auto endp = c.fill_neighbours_unique({0,6,4}, n, s);
+  ASSERT_EQ(13, std::distance(&n[0], endp));
+  EXPECT_EQ(&c(4,5,3), n[0]);
+  EXPECT_EQ(cube_shift(-1,0,0), s[0]);
+  EXPECT_EQ(&c(4,0,3), n[4]);
+  EXPECT_EQ(cube_shift(-1,1,0), s[4]);
+  EXPECT_EQ(&c(1,0,3), n[12]);
+  EXPECT_EQ(cube_shift(0,1,0), s[12]);
+}
+
+TYPED_TEST(cube_test, periodic_unique_pairs_once)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{3,4,5};
+  c.set_periodic(true, true, true);
+  std::map<std::pair<const TypeParam*,const TypeParam*>,int> pairs;
+  for (size_t k=0; k<5; ++k) {
+    for (size_t j=0; j<4; ++j) {
+      for (size_t i=0; i<3; ++i) {
+        const TypeParam * p = &c(i,j,k);
+        c.for_all_neighbours_unique_shifted({i,j,k}, [&](TypeParam & x, const cube_shift & s) {
+          EXPECT_FALSE(s.get<0>() != 0 && i!=0 && i!=2);
+          auto key = (p<&x) ? std::make_pair(p,(const TypeParam*)&x) : std::make_pair((const TypeParam*)&x,p);
+          ++pairs[key];
+        });
+      }
+    }
+  }
+  // Each cell has 26 distinct neighbours in a 3x4x5 periodic box
+  EXPECT_EQ(3u*4u*5u*13u, pairs.size());
+  for (auto & x : pairs) {
+    EXPECT_EQ(1, x.second);
+  }
+}
+
+TYPED_TEST(cube_test, interior)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,7,9};
+  EXPECT_TRUE(c.interior(1,1,1));
+  EXPECT_TRUE(c.interior(3,5,7));
+  EXPECT_FALSE(c.interior(0,3,3));
+  EXPECT_FALSE(c.interior(4,3,3));
+  EXPECT_FALSE(c.interior(2,6,3));
+  EXPECT_FALSE(c.interior(2,3,0));
+  EXPECT_FALSE(c.interior(2,3,8));
+}
+
+TYPED_TEST(cube_test, unique_neighbour_offsets)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,7,9};
+  const std::ptrdiff_t * d = c.unique_neighbour_offsets();
+  std::vector<TypeParam*> v;
+  c.for_all_neighbours_unique(2,3,4, [&v](TypeParam & x) { v.push_back(&x); });
+  ASSERT_EQ(13u, v.size());
+  for (int n=0; n<13; ++n) {
+    EXPECT_EQ(&c(2,3,4) + d[n], v[n]);
+    auto o = neighbour_half_shell[n];
+    EXPECT_EQ(&c(2+o.dx, 3+o.dy, 4+o.dz), v[n]);
+  }
+}
+
+TYPED_TEST(cube_test, neighbour_offsets)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,7,9};
+  const std::ptrdiff_t * d = c.neighbour_offsets();
+  std::vector<TypeParam*> v;
+  c.for_all_neighbours(2,3,4, [&v](TypeParam & x) { v.push_back(&x); });
+  ASSERT_EQ(26u, v.size());
+  for (int n=0; n<26; ++n) {
+    EXPECT_EQ(&c(2,3,4) + d[n], v[n]);
+  }
+}
+
+TYPED_TEST(cube_test, boundary_follows_table_order)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,7,9};
+  std::vector<TypeParam*> v;
+  c.for_all_neighbours_unique(0,3,4, [&v](TypeParam & x) { v.push_back(&x); });
+  std::vector<TypeParam*> expected;
+  for (auto o : neighbour_half_shell) {
+    if (o.dx>=0) expected.push_back(&c(o.dx, 3+o.dy, 4+o.dz));
+  }
+  EXPECT_EQ(expected, v);
+}
+
+template <typename P>
+class cube_pairs_test : public ::testing::Test {
+public:
+  using cube_type = cube<int, P>;
+};
+
+typedef ::testing::Types<
+  policy<sequential_executor<int>>,
+  policy<thread_executor<int>>
+> pairs_test_types;
+TYPED_TEST_CASE(cube_pairs_test, pairs_test_types);
+
+namespace {
+
+// Counts the pairs touching every cell and checks against its neighbours
+template <typename C>
+void check_pair_counts(C & c)
+{
+  c.all().apply([](int & x) { x = 0; });
+  c.apply_cell_pairs([](int & a, int & b) { ++a; ++b; });
+  for (size_t k=0; k<c.size_z(); ++k) {
+    for (size_t j=0; j<c.size_y(); ++j) {
+      for (size_t i=0; i<c.size_x(); ++i) {
+        int n = 0;
+        c.for_all_neighbours(i, j, k, [&n](int &) { ++n; });
+        EXPECT_EQ(n, c(i,j,k)) << cube_index(i,j,k);
+      }
+    }
+  }
+}
+
+}
+
+TYPED_TEST(cube_pairs_test, all_pairs)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{7,8,9};
+  check_pair_counts(c);
+}
+
+TYPED_TEST(cube_pairs_test, small)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{1,2,3};
+  check_pair_counts(c);
+}
+
+TYPED_TEST(cube_pairs_test, periodic)
+{
+  using cube = typename TestFixture::cube_type;
+  for (size_t n=3; n<9; ++n) {
+    cube c{n,n+1,n+2};
+    c.set_periodic(true, true, true);
+    check_pair_counts(c);
+  }
+}
+
+TYPED_TEST(cube_pairs_test, pairs_once)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{4,5,7};
+  c.set_periodic(true, false, true);
+  std::map<std::pair<const int*,const int*>,int> pairs;
+  std::mutex m;
+  c.apply_cell_pairs([&](int & a, int & b) {
+    std::lock_guard<std::mutex> l{m};
+    ++pairs[(&a<&b) ? std::make_pair(&a,&b) : std::make_pair(&b,&a)];
+  });
+  for (auto & x : pairs) {
+    EXPECT_EQ(1, x.second);
+  }
+}
+
+TYPED_TEST(cube_pairs_test, shifts)
+{
+  using cube = typename TestFixture::cube_type;
+  cube open{5,6,7};
+  std::atomic<int> inside{0};
+  open.apply_cell_pairs([&inside](int &, int &) { ++inside; });
+
+  cube c{5,6,7};
+  c.set_periodic(true, true, true);
+  std::atomic<int> all{0};
+  std::atomic<int> wrapped{0};
+  c.apply_cell_pairs_shifted([&](int &, int &, const cube_shift & s) {
+    ++all;
+    if (!s.is_zero()) ++wrapped;
+  });
+  EXPECT_EQ(5*6*7*13, all);
+  EXPECT_EQ(all - inside, wrapped);
+}
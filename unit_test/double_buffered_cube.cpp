@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#include "double_buffered_cube.h"
+#include "policy.h"
+#include "threadexecutor.h"
+#include <gtest/gtest.h>
+#include <functional>
+
+using namespace yapl;
+using namespace std;
+
+template <typename P>
+class double_buffered_cube_test : public ::testing::Test {
+public:
+  using cube_type = double_buffered_cube<int, P>;
+  using neighbourhood = typename cube_type::neighbourhood_type;
+};
+
+typedef ::testing::Types<
+  policy<sequential_executor<int>>,
+  policy<thread_executor<int>>,
+  policy<thread_executor<int>, default_partitioner, 0, new_allocation, morton_layout>
+> my_test_types;
+TYPED_TEST_CASE(double_buffered_cube_test, my_test_types);
+
+namespace {
+
+int value_of(size_t i, size_t j, size_t k)
+{
+  return i + 10 * j + 100 * k;
+}
+
+template <typename C>
+void set_positions(C & c)
+{
+  c.current().all().apply_indexed([](int & x, const cube_index & i) {
+    x = value_of(i.get<0>(), i.get<1>(), i.get<2>());
+  });
+}
+
+}
+
+TYPED_TEST(double_buffered_cube_test, sizes)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{3,4,5};
+  EXPECT_EQ(3u, c.size_x());
+  EXPECT_EQ(4u, c.size_y());
+  EXPECT_EQ(5u, c.template size<2>());
+  EXPECT_EQ(0u, c.steps());
+}
+
+TYPED_TEST(double_buffered_cube_test, step_flips_buffers)
+{
+  using cube = typename TestFixture::cube_type;
+  using neighbourhood = typename TestFixture::neighbourhood;
+  cube c{3,4,5};
+  set_positions(c);
+  const int * before = &c.current()(0,0,0);
+  c.apply_stencil([](int & x, const neighbourhood & n) {
+    const cube_index & i = n.index();
+    EXPECT_EQ(value_of(i.get<0>(), i.get<1>(), i.get<2>()), n.centre());
+    x = 2 * n.centre();
+  });
+  EXPECT_EQ(1u, c.steps());
+  EXPECT_EQ(before, &c.previous()(0,0,0));
+  EXPECT_EQ(value_of(2,3,4), c.previous()(2,3,4));
+  EXPECT_EQ(2 * value_of(2,3,4), c.current()(2,3,4));
+}
+
+TYPED_TEST(double_buffered_cube_test, reads_previous_state)
+{
+  using cube = typename TestFixture::cube_type;
+  using neighbourhood = typename TestFixture::neighbourhood;
+  cube c{6,5,4};
+  c.current().all().apply([](int & x) { x = 1; });
+  // Every cell adds its x-neighbours. Reading cells written in the same
+  // step would give other results.
+  for (int step=0; step<3; ++step) {
+    c.apply_stencil([](int & x, const neighbourhood & n) {
+      x = n.centre();
+      if (n.contains(-1,0,0)) x += n(-1,0,0);
+      if (n.contains(1,0,0)) x += n(1,0,0);
+    });
+  }
+  // Rows: 1 1 1 1 1 1 -> 2 3 3 3 3 2 -> 5 8 9 9 8 5 -> 13 22 26 26 22 13
+  const int expected[6] = {13, 22, 26, 26, 22, 13};
+  for (size_t i=0; i<6; ++i) {
+    EXPECT_EQ(expected[i], c.current()(i,2,3)) << i;
+  }
+}
+
+TYPED_TEST(double_buffered_cube_test, neighbourhood_offsets)
+{
+  using cube = typename TestFixture::cube_type;
+  using neighbourhood = typename TestFixture::neighbourhood;
+  cube c{4,5,6};
+  set_positions(c);
+  c.apply_stencil([](int & x, const neighbourhood & n) {
+    const cube_index & i = n.index();
+    EXPECT_EQ(i.get<0>()>0, n.contains(-1,0,0));
+    EXPECT_EQ(i.get<2>()<4, n.contains(0,0,2));
+    if (n.contains(1,-1,2)) {
+      EXPECT_EQ(value_of(i.get<0>()+1, i.get<1>()-1, i.get<2>()+2), n(1,-1,2));
+    }
+    x = 0;
+  });
+}
+
+TYPED_TEST(double_buffered_cube_test, periodic)
+{
+  using cube = typename TestFixture::cube_type;
+  using neighbourhood = typename TestFixture::neighbourhood;
+  cube c{4,5,6};
+  c.set_periodic(true, false, true);
+  set_positions(c);
+  c.apply_stencil([](int & x, const neighbourhood & n) {
+    EXPECT_TRUE(n.contains(-1,0,-7));
+    x = n(-1,0,0) + n(0,0,7);
+  });
+  EXPECT_EQ(value_of(3,2,0) + value_of(0,2,1), c.current()(0,2,0));
+  EXPECT_EQ(value_of(2,4,5) + value_of(3,4,0), c.current()(3,4,5));
+}
+
+TYPED_TEST(double_buffered_cube_test, diffusion_conserves_total)
+{
+  using cube = typename TestFixture::cube_type;
+  using neighbourhood = typename TestFixture::neighbourhood;
+  cube c{8,8,8};
+  c.set_periodic(true, true, true);
+  c.current().all().apply([](int & x) { x = 0; });
+  c.current()(3,4,5) = 1 << 20;
+  for (int step=0; step<4; ++step) {
+    c.apply_stencil([](int & x, const neighbourhood & n) {
+      // Half stays, the rest moves to the x and y faces (exact for powers of two)
+      x = n.centre() / 2 + n(-1,0,0) / 8 + n(1,0,0) / 8 + n(0,-1,0) / 8 + n(0,1,0) / 8;
+    });
+  }
+  EXPECT_EQ(4u, c.steps());
+  EXPECT_EQ(1 << 20, c.current().all().reduce(0, std::plus<int>{}));
+}
@@ -0,0 +1,329 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#include "seqexecutor.h"
+#include "threadexecutor.h"
+#include "cube.h"
+#include "policy.h"
+#ifdef YAPL_HAVE_TBB
+#include "tbbexecutor.h"
+#endif
+#ifdef YAPL_HAVE_OPENMP
+#include "ompexecutor.h"
+#endif
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+
+using namespace yapl;
+using namespace std;
+
+template <typename E>
+class executor_test : public ::testing::Test {
+public:
+  using executor_type = E;
+};
+
+typedef ::testing::Types<
+  sequential_executor<double>,
+  thread_executor<double>,
+  thread_executor<double, tile_shape<3,2,2>>
+#ifdef YAPL_HAVE_TBB
+  , tbb_executor<double>
+  , tbb_executor<double, tile_shape<3,2,2>>
+#endif
+#ifdef YAPL_HAVE_OPENMP
+  , openmp_executor<double>
+#endif
+> my_test_types;
+TYPED_TEST_CASE(executor_test, my_test_types);
+
+TYPED_TEST(executor_test, apply)
+{
+  using executor = typename TestFixture::executor_type;
+  std::vector<double> v(1000);
+  executor::apply([](double & x) { x+=1; }, v.data(), v.size());
+  for (auto x : v) {
+    ASSERT_EQ(1.0, x);
+  }
+}
+
+TYPED_TEST(executor_test, apply_indexed)
+{
+  using executor = typename TestFixture::executor_type;
+  const size_t nx=67, ny=9, nz=5;
+  std::vector<double> v(nx*ny*nz);
+  executor::apply([](double & x, const cube_index & i) {
+    x += i.get<0>() + 100 * i.get<1>() + 10000 * i.get<2>();
+  }, v.data(), nx, ny, nz);
+  for (size_t k=0; k<nz; ++k) {
+    for (size_t j=0; j<ny; ++j) {
+      for (size_t i=0; i<nx; ++i) {
+        ASSERT_EQ(double(i + 100*j + 10000*k), v[i + nx*(j + ny*k)]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(executor_test, apply_indexed_int_extents)
+{
+  // int lvalue extents must select the indexed sweep, not a partitioned one
+  using executor = typename TestFixture::executor_type;
+  int nx=4, ny=3, nz=2;
+  std::vector<double> v(nx*ny*nz);
+  executor::apply([](double & x, const cube_index & i) {
+    x = i.get<0>() + 10 * i.get<1>() + 100 * i.get<2>();
+  }, v.data(), nx, ny, nz);
+  EXPECT_EQ(123.0, v[3 + nx*(2 + ny*1)]);
+}
+
+TYPED_TEST(executor_test, apply_ordered)
+{
+  using executor = typename TestFixture::executor_type;
+  std::vector<double> v(100);
+  double n = 0;
+  executor::apply_ordered([&n](double & x) { x=n++; }, v.data(), v.size());
+  for (size_t i=0; i<v.size(); ++i) {
+    ASSERT_EQ(double(i), v[i]);
+  }
+}
+
+TYPED_TEST(executor_test, apply_ordered_indexed)
+{
+  using executor = typename TestFixture::executor_type;
+  const size_t nx=4, ny=3, nz=2;
+  std::vector<double> v(nx*ny*nz);
+  double n = 0;
+  executor::apply_ordered([&n](double & x, const cube_index & i) {
+    x = n++;
+    ASSERT_EQ(x, double(i.get<0>() + nx * (i.get<1>() + ny * i.get<2>())));
+  }, v.data(), nx, ny, nz);
+  for (size_t i=0; i<v.size(); ++i) {
+    ASSERT_EQ(double(i), v[i]);
+  }
+}
+
+TYPED_TEST(executor_test, cube_fill)
+{
+  using executor = typename TestFixture::executor_type;
+  cube<double, policy<executor>> c{13,7,5};
+  c.all().apply_indexed([](double & x, const cube_index & i) {
+    x = i.get<0>() + i.get<1>() + i.get<2>();
+  });
+  c.all().apply([](double & x) { x *= 2; });
+  for (size_t i=0; i<c.size_x(); ++i) {
+    for (size_t j=0;j<c.size_y(); ++j) {
+      for (size_t k=0;k<c.size_z(); ++k) {
+        ASSERT_EQ(double(2*(i+j+k)), c(i,j,k));
+      }
+    }
+  }
+}
+
+TYPED_TEST(executor_test, apply_ordered_commit)
+{
+  using executor = typename TestFixture::executor_type;
+  std::vector<double> v(100000);
+  for (size_t i=0; i<v.size(); ++i) {
+    v[i] = i;
+  }
+  std::vector<double> out;
+  executor::apply_ordered(
+    [](double & x) { x *= 2; return x + 1; },
+    [&out](double r) { out.push_back(r); },
+    v.data(), v.size());
+  ASSERT_EQ(v.size(), out.size());
+  for (size_t i=0; i<v.size(); ++i) {
+    ASSERT_EQ(double(2*i), v[i]);
+    ASSERT_EQ(double(2*i+1), out[i]);
+  }
+}
+
+TYPED_TEST(executor_test, apply_ordered_indexed_commit)
+{
+  using executor = typename TestFixture::executor_type;
+  const size_t nx=67, ny=9, nz=5;
+  std::vector<double> v(nx*ny*nz);
+  std::vector<size_t> out;
+  executor::apply_ordered(
+    [](double & x, const cube_index & i) { 
+      x = i.get<0>() + 100 * i.get<1>() + 10000 * i.get<2>();
+      return i.get<0>() + nx * (i.get<1>() + ny * i.get<2>());
+    },
+    [&out](size_t r) { out.push_back(r); },
+    v.data(), nx, ny, nz);
+  ASSERT_EQ(v.size(), out.size());
+  for (size_t i=0; i<out.size(); ++i) {
+    ASSERT_EQ(i, out[i]);
+  }
+  for (size_t k=0; k<nz; ++k) {
+    for (size_t j=0; j<ny; ++j) {
+      for (size_t i=0; i<nx; ++i) {
+        ASSERT_EQ(double(i + 100*j + 10000*k), v[i + nx*(j + ny*k)]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(executor_test, block_grain)
+{
+  using executor = typename TestFixture::executor_type;
+  block<double, policy<executor, default_partitioner, 16>> b(1000);
+  for (int step=0; step<3; ++step) {
+    b.apply([](double & x) { x+=1; }, 1000);
+  }
+  for (size_t i=0; i<1000; ++i) {
+    ASSERT_EQ(3.0, b[i]);
+  }
+}
+
+#ifdef YAPL_HAVE_TBB
+template <typename P>
+class tbb_partitioner_test : public ::testing::Test {
+public:
+  using cube_type = cube<double, policy<tbb_executor<double>, P, 64>>;
+};
+
+typedef ::testing::Types<
+  tbb::affinity_partitioner,
+  tbb::simple_partitioner,
+  tbb::static_partitioner
+> partitioner_types;
+TYPED_TEST_CASE(tbb_partitioner_test, partitioner_types);
+
+TYPED_TEST(tbb_partitioner_test, repeated_sweeps)
+{
+  typename TestFixture::cube_type c{31,17,5};
+  for (int step=0; step<3; ++step) {
+    c.all().apply([](double & x) { x+=1; });
+    c.all().apply_indexed([](double & x, const cube_index & i) { x+=i.get<0>(); });
+  }
+  for (size_t i=0; i<c.size_x(); ++i) {
+    for (size_t j=0;j<c.size_y(); ++j) {
+      for (size_t k=0;k<c.size_z(); ++k) {
+        ASSERT_EQ(double(3 + 3*i), c(i,j,k));
+      }
+    }
+  }
+}
+#endif
+
+TYPED_TEST(executor_test, apply_range)
+{
+  using executor = typename TestFixture::executor_type;
+  std::vector<int> v(10007);
+  default_partitioner part;
+  for (size_t grain : {size_t{0}, size_t{100}}) {
+    executor::apply_range([&v](size_t first, size_t last) {
+      for (auto i=first; i!=last; ++i) { v[i]++; }
+    }, v.size(), grain, part);
+  }
+  for (auto x : v) {
+    ASSERT_EQ(2, x);
+  }
+  executor::apply_range([](size_t, size_t) { FAIL(); }, 0, 0, part);
+}
+
+TYPED_TEST(executor_test, reduce_range)
+{
+  using executor = typename TestFixture::executor_type;
+  const size_t n = 100000;
+  auto sum = [](size_t first, size_t last) {
+    size_t s = 0;
+    for (auto i=first; i!=last; ++i) { s += i; }
+    return s;
+  };
+  auto plus = [](size_t x, size_t y) { return x+y; };
+  EXPECT_EQ(7 + n*(n-1)/2, executor::reduce_range(n, size_t{7}, plus, sum, unordered_reduction{}));
+  EXPECT_EQ(7 + n*(n-1)/2, executor::reduce_range(n, size_t{7}, plus, sum, deterministic_reduction{}));
+  EXPECT_EQ(7u, executor::reduce_range(0, size_t{7}, plus, sum, unordered_reduction{}));
+  EXPECT_EQ(7u, executor::reduce_range(0, size_t{7}, plus, sum, deterministic_reduction{}));
+}
+
+TYPED_TEST(executor_test, reduce_range_deterministic)
+{
+  using executor = typename TestFixture::executor_type;
+  const size_t n = 100003;
+  auto sum = [](size_t first, size_t last) {
+    float s = 1.0f / (first + 1);
+    for (auto i=first+1; i!=last; ++i) { s += 1.0f / (i + 1); }
+    return s;
+  };
+  auto plus = [](float x, float y) { return x+y; };
+  float expected = sequential_executor<double>::reduce_range(n, 0.5f, plus, sum, deterministic_reduction{});
+  float result = executor::reduce_range(n, 0.5f, plus, sum, deterministic_reduction{});
+  EXPECT_EQ(expected, result);
+}
+
+TYPED_TEST(executor_test, cube_first_touch)
+{
+  using executor = typename TestFixture::executor_type;
+  cube<double, policy<executor>> c{13,7,5, first_touch_init};
+  for (size_t i=0; i<c.size_x(); ++i) {
+    for (size_t j=0;j<c.size_y(); ++j) {
+      for (size_t k=0;k<c.size_z(); ++k) {
+        ASSERT_EQ(0.0, c(i,j,k));
+      }
+    }
+  }
+}
+
+// Executors that propagate exceptions thrown by the functor. OpenMP
+// terminates the program when an exception leaves a parallel region.
+template <typename E>
+class executor_exception_test : public ::testing::Test {
+public:
+  using executor_type = E;
+};
+
+typedef ::testing::Types<
+  sequential_executor<double>,
+  thread_executor<double>
+#ifdef YAPL_HAVE_TBB
+  , tbb_executor<double>
+#endif
+> exception_test_types;
+TYPED_TEST_CASE(executor_exception_test, exception_test_types);
+
+TYPED_TEST(executor_exception_test, apply_throws)
+{
+  using executor = typename TestFixture::executor_type;
+  std::vector<double> v(10000);
+  for (int r=0; r<10; ++r) {
+    EXPECT_THROW(executor::apply([](double & x) {
+        if (x == 0) throw std::runtime_error{"apply"};
+      }, v.data(), v.size()), std::runtime_error);
+  }
+  // The executor is still usable afterwards
+  executor::apply([](double & x) { x+=1; }, v.data(), v.size());
+  for (auto x : v) {
+    ASSERT_EQ(1.0, x);
+  }
+}
+
+TYPED_TEST(executor_exception_test, apply_range_throws_once)
+{
+  using executor = typename TestFixture::executor_type;
+  default_partitioner part;
+  EXPECT_THROW(executor::apply_range([](size_t first, size_t last) {
+      if (first <= 5000 && 5000 < last) throw std::logic_error{"range"};
+    }, 10000, 1, part), std::logic_error);
+}
@@ -22,6 +22,7 @@ SOFTWARE.
 #include "block.h"
 #include "cube_mapping.h"
 #include "policy.h"
+#include "algorithm.h"
 #include <gtest/gtest.h>
 
 using namespace yapl;
@@ -63,3 +64,38 @@ TYPED_TEST(full_cube_mapping_test, apply_indexed)
   });
 
 }
+
+TYPED_TEST(full_cube_mapping_test, reduce)
+{
+  using block_type = typename TestFixture::block_type;
+  block_type b(24);
+  full_cube_mapping<block_type> all(&b,2,3,4);
+  all.apply([](TypeParam& x) { x=2;});
+  auto plus = [](TypeParam x, TypeParam y) { return x+y; };
+  EXPECT_EQ(TypeParam{49}, all.reduce(TypeParam{1}, plus));
+  EXPECT_EQ(TypeParam{49}, all.reduce(TypeParam{1}, plus, deterministic_reduction{}));
+  EXPECT_EQ(TypeParam{49}, yapl::reduce(all, TypeParam{1}, plus));
+}
+
+TYPED_TEST(full_cube_mapping_test, transform_reduce)
+{
+  using block_type = typename TestFixture::block_type;
+  block_type b(24);
+  full_cube_mapping<block_type> all(&b,2,3,4);
+  all.apply([](TypeParam& x) { x=2;});
+  auto max = [](TypeParam x, TypeParam y) { return std::max(x,y); };
+  b[17] = -5;
+  EXPECT_EQ(TypeParam{5}, all.transform_reduce(TypeParam{0}, max, [](TypeParam & x) { return std::abs(x); }));
+}
+
+TYPED_TEST(full_cube_mapping_test, transform_reduce_indexed)
+{
+  using block_type = typename TestFixture::block_type;
+  block_type b(24);
+  full_cube_mapping<block_type> all(&b,2,3,4);
+  size_t n = all.transform_reduce_indexed(size_t{0}, 
+    [](size_t x, size_t y) { return x+y; },
+    [](TypeParam &, const cube_index & i) { return i.get<0>() + i.get<1>() + i.get<2>(); });
+  // sum of i+j+k over 2x3x4 cube
+  EXPECT_EQ(12u*1 + 8u*3 + 6u*6, n);
+}
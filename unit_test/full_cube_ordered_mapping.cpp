@@ -63,3 +63,31 @@ TYPED_TEST(full_cube_ordered_mapping_test, apply_indexed)
   });
 
 }
+
+TYPED_TEST(full_cube_ordered_mapping_test, apply_commit)
+{
+  using block_type = typename TestFixture::block_type;
+  block_type b(24);
+  full_cube_ordered_mapping<block_type> all(&b,2,3,4);
+  TypeParam n{};
+  all.apply([](TypeParam & x) { x=1; return x; }, [&n](TypeParam x) { n+=x; });
+  EXPECT_EQ(TypeParam{24}, n);
+}
+
+TYPED_TEST(full_cube_ordered_mapping_test, apply_indexed_commit)
+{
+  using block_type = typename TestFixture::block_type;
+  block_type b(24);
+  full_cube_ordered_mapping<block_type> all(&b,2,3,4);
+  std::vector<size_t> v;
+  all.apply_indexed(
+    [](TypeParam &, const cube_index & i) { 
+      return i.get<0>() + 2 * (i.get<1>() + 3 * i.get<2>());
+    },
+    [&v](size_t i) { v.push_back(i); }
+  );
+  ASSERT_EQ(24u, v.size());
+  for (size_t i=0; i<v.size(); ++i) {
+    EXPECT_EQ(i, v[i]);
+  }
+}
@@ -53,6 +53,20 @@ TYPED_TEST(full_list_mapping_test, apply)
   }
 }
 
+TYPED_TEST(full_list_mapping_test, reduce)
+{
+  using list_type = typename TestFixture::list_type;
+  list_type b;
+  for (int i=0;i<50; ++i) {
+    b.add(i);
+  }
+  full_list_mapping<list_type> all(&b);
+  auto plus = [](TypeParam x, TypeParam y) { return x+y; };
+  EXPECT_EQ(1225, all.reduce(0, plus));
+  EXPECT_EQ(1225, all.reduce(0, plus, deterministic_reduction{}));
+  EXPECT_EQ(2450, all.transform_reduce(0, plus, [](const TypeParam & x) { return 2*x; }));
+}
+
 TYPED_TEST(full_list_mapping_test, apply_cartesian_unique)
 {
 /*
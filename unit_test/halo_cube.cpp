@@ -0,0 +1,185 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#include "halo_cube.h"
+#include "cube.h"
+#include "policy.h"
+#include "threadexecutor.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace yapl;
+using namespace std;
+
+template <typename P>
+class halo_cube_test : public ::testing::Test {
+public:
+  using cube_type = halo_cube<int, P>;
+  using wide_cube_type = halo_cube<int, P, 2>;
+};
+
+typedef ::testing::Types<
+  policy<sequential_executor<int>>,
+  policy<thread_executor<int>>
+> my_test_types;
+TYPED_TEST_CASE(halo_cube_test, my_test_types);
+
+namespace {
+
+int value_of(std::ptrdiff_t i, std::ptrdiff_t j, std::ptrdiff_t k)
+{
+  return 1 + i + 10 * j + 100 * k;
+}
+
+}
+
+TYPED_TEST(halo_cube_test, sizes)
+{
+  using cube = typename TestFixture::wide_cube_type;
+  cube c{3,4,5};
+  EXPECT_EQ((cube_index{3,4,5}), c.size());
+  EXPECT_EQ((cube_index{7,8,9}), c.padded_size());
+  EXPECT_EQ(0, c(2,3,4));
+  EXPECT_EQ(0, c.at(-2,-2,-2));
+  EXPECT_EQ(0, c.at(4,5,6));
+}
+
+TYPED_TEST(halo_cube_test, interior_apply)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,6,7};
+  c.interior().apply_indexed([](int & x, const cube_index & i) {
+    x = value_of(i.get<0>(), i.get<1>(), i.get<2>());
+  });
+  c.interior().apply([](int & x) { x *= 2; });
+  EXPECT_EQ(2 * value_of(4,5,6), c(4,5,6));
+  EXPECT_EQ(0, c.at(-1,0,0));
+  EXPECT_EQ(0, c.at(5,5,6));
+  auto plus = [](int x, int y) { return x+y; };
+  const cube & cc = c;
+  EXPECT_EQ(2*5*6*7, cc.interior().transform_reduce(0, plus, [](int x) { return x > 0 ? 2 : 0; }));
+  EXPECT_EQ(c.interior().reduce(0, plus), c.interior().reduce(0, plus, deterministic_reduction{}));
+}
+
+TYPED_TEST(halo_cube_test, zero_boundary)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{4,5,6};
+  for (std::ptrdiff_t k=-1; k<=6; ++k) {
+    for (std::ptrdiff_t j=-1; j<=5; ++j) {
+      for (std::ptrdiff_t i=-1; i<=4; ++i) {
+        c.at(i,j,k) = 7;
+      }
+    }
+  }
+  c.fill_halo(zero_boundary{});
+  EXPECT_EQ(0, c.at(-1,2,3));
+  EXPECT_EQ(0, c.at(4,5,6));
+  EXPECT_EQ(0, c.at(2,-1,6));
+  EXPECT_EQ(7, c(0,0,0));
+  EXPECT_EQ(7, c(3,4,5));
+}
+
+TYPED_TEST(halo_cube_test, copy_boundary)
+{
+  using cube = typename TestFixture::wide_cube_type;
+  cube c{4,5,6};
+  c.fill_halo(make_copy_boundary(3));
+  EXPECT_EQ(3, c.at(-2,-2,-2));
+  EXPECT_EQ(3, c.at(-1,2,3));
+  EXPECT_EQ(3, c.at(5,6,7));
+  EXPECT_EQ(0, c(0,0,0));
+}
+
+TYPED_TEST(halo_cube_test, clamp_boundary)
+{
+  using cube = typename TestFixture::wide_cube_type;
+  cube c{4,5,6};
+  c.interior().apply_indexed([](int & x, const cube_index & i) {
+    x = value_of(i.get<0>(), i.get<1>(), i.get<2>());
+  });
+  c.fill_halo(clamp_boundary{});
+  EXPECT_EQ(value_of(0,2,3), c.at(-2,2,3));
+  EXPECT_EQ(value_of(3,4,5), c.at(5,6,7));
+  EXPECT_EQ(value_of(0,0,5), c.at(-1,-2,6));
+  EXPECT_EQ(value_of(2,4,0), c.at(2,5,-1));
+}
+
+TYPED_TEST(halo_cube_test, periodic_boundary)
+{
+  using cube = typename TestFixture::wide_cube_type;
+  cube c{4,5,6};
+  c.interior().apply_indexed([](int & x, const cube_index & i) {
+    x = value_of(i.get<0>(), i.get<1>(), i.get<2>());
+  });
+  c.fill_halo(periodic_boundary{});
+  for (std::ptrdiff_t k=-2; k<8; ++k) {
+    for (std::ptrdiff_t j=-2; j<7; ++j) {
+      for (std::ptrdiff_t i=-2; i<6; ++i) {
+        ASSERT_EQ(value_of((i+4)%4, (j+5)%5, (k+6)%6), c.at(i,j,k));
+      }
+    }
+  }
+}
+
+TYPED_TEST(halo_cube_test, neighbours_match_cube_inside)
+{
+  using halo = typename TestFixture::cube_type;
+  using reference_cube = cube<int, default_policy<int>>;
+  halo h{5,6,7};
+  reference_cube r{5,6,7};
+  auto set = [](int & x, const cube_index & i) { x = value_of(i.get<0>(), i.get<1>(), i.get<2>()); };
+  h.interior().apply_indexed(set);
+  r.all().apply_indexed(set);
+  h.fill_halo(zero_boundary{});
+  for (size_t k=0; k<7; ++k) {
+    for (size_t j=0; j<6; ++j) {
+      for (size_t i=0; i<5; ++i) {
+        std::vector<int> vh, vr;
+        h.for_all_neighbours(i,j,k, [&vh](int x) { if (x) vh.push_back(x); });
+        r.for_all_neighbours(i,j,k, [&vr](int x) { vr.push_back(x); });
+        ASSERT_EQ(vr, vh);
+        vh.clear();
+        vr.clear();
+        h.for_all_neighbours_unique(cube_index{i,j,k}, [&vh](int x) { if (x) vh.push_back(x); });
+        r.for_all_neighbours_unique(cube_index{i,j,k}, [&vr](int x) { vr.push_back(x); });
+        ASSERT_EQ(vr, vh);
+      }
+    }
+  }
+}
+
+TYPED_TEST(halo_cube_test, fill_neighbours_unique)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{3,3,3};
+  c.interior().apply_indexed([](int & x, const cube_index & i) {
+    x = value_of(i.get<0>(), i.get<1>(), i.get<2>());
+  });
+  c.fill_halo(periodic_boundary{});
+  int * v[13];
+  EXPECT_EQ(v+13, c.fill_neighbours_unique(0,0,0,v));
+  EXPECT_EQ(value_of(2,2,2), *v[0]);
+  EXPECT_EQ(value_of(2,2,0), *v[1]);
+  EXPECT_EQ(v+13, c.fill_neighbours_unique(cube_index{1,1,1},v));
+  EXPECT_EQ(value_of(0,0,0), *v[0]);
+  EXPECT_EQ(value_of(2,2,0), *v[12]);
+}
@@ -0,0 +1,350 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#include "layout.h"
+#include "cube.h"
+#include "policy.h"
+#include "soa.h"
+#include "threadexecutor.h"
+#ifdef YAPL_HAVE_TBB
+#include "tbbexecutor.h"
+#endif
+#ifdef YAPL_HAVE_OPENMP
+#include "ompexecutor.h"
+#endif
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace yapl;
+using namespace std;
+
+template <typename L>
+class layout_test : public ::testing::Test {
+public:
+  using layout_type = L;
+  using policy_type = policy<sequential_executor<int>, default_partitioner, 0, new_allocation, L>;
+  using parallel_policy_type = policy<thread_executor<int>, default_partitioner, 0, new_allocation, L>;
+};
+
+typedef ::testing::Types<
+  row_major_layout,
+  brick_layout<4,4,4>,
+  brick_layout<2,3,2>,
+  brick_layout<8,8,8>,
+  morton_layout,
+  hilbert_layout
+> my_test_types;
+TYPED_TEST_CASE(layout_test, my_test_types);
+
+TYPED_TEST(layout_test, index_is_bijective)
+{
+  using layout = typename TestFixture::layout_type;
+  const cube_index n{7,5,6};
+  std::vector<int> seen(layout::size(n));
+  for (size_t k=0; k<6; ++k) {
+    for (size_t j=0; j<5; ++j) {
+      for (size_t i=0; i<7; ++i) {
+        auto p = layout::index(i,j,k,n);
+        ASSERT_LT(p, seen.size());
+        seen[p]++;
+      }
+    }
+  }
+  size_t cells = 0;
+  for (auto x : seen) {
+    ASSERT_GE(1, x);
+    cells += x;
+  }
+  EXPECT_EQ(n.volume(), cells);
+  if (!layout::padded) {
+    EXPECT_EQ(n.volume(), layout::size(n));
+  }
+}
+
+TYPED_TEST(layout_test, visit_inverts_index)
+{
+  using layout = typename TestFixture::layout_type;
+  const cube_index n{7,5,6};
+  size_t next = 3;
+  size_t cells = 0;
+  layout::visit([&](size_t p, const cube_index & i) {
+    EXPECT_LE(next, p);
+    EXPECT_LT(p, layout::size(n) - 2);
+    next = p + 1;
+    EXPECT_EQ(p, layout::index(i.template get<0>(), i.template get<1>(), i.template get<2>(), n));
+    cells++;
+  }, n, 3, layout::size(n) - 2);
+  layout::visit([&](size_t, const cube_index &) { cells++; }, n, 0, 3);
+  layout::visit([&](size_t, const cube_index &) { cells++; }, n, layout::size(n) - 2, layout::size(n));
+  EXPECT_EQ(n.volume(), cells);
+}
+
+TYPED_TEST(layout_test, power_of_two_sizes)
+{
+  using layout = typename TestFixture::layout_type;
+  const cube_index n{8,8,8};
+  EXPECT_EQ(512u, layout::size(n));
+  EXPECT_EQ(0u, layout::index(0,0,0,n));
+}
+
+TEST(layout_test, morton_order)
+{
+  const cube_index n{4,4,4};
+  EXPECT_EQ(1u, morton_layout::index(1,0,0,n));
+  EXPECT_EQ(2u, morton_layout::index(0,1,0,n));
+  EXPECT_EQ(4u, morton_layout::index(0,0,1,n));
+  EXPECT_EQ(7u, morton_layout::index(1,1,1,n));
+  EXPECT_EQ(8u, morton_layout::index(2,0,0,n));
+  // Exhausted axes drop out of the interleaving
+  const cube_index flat{8,2,1};
+  EXPECT_EQ(16u, morton_layout::size(flat));
+  EXPECT_EQ(3u, morton_layout::index(1,1,0,flat));
+  EXPECT_EQ(4u, morton_layout::index(2,0,0,flat));
+  EXPECT_EQ(8u, morton_layout::index(4,0,0,flat));
+}
+
+TEST(layout_test, hilbert_steps_to_face_neighbours)
+{
+  const cube_index n{8,8,8};
+  std::vector<cube_index> cells(hilbert_layout::size(n), cube_index{0,0,0});
+  hilbert_layout::visit([&cells](size_t p, const cube_index & i) { cells[p] = i; }, n, 0, cells.size());
+  for (size_t p=1; p<cells.size(); ++p) {
+    int d = 0;
+    for (int a=0; a<3; ++a) {
+      const size_t x = (a==0) ? cells[p].get<0>() : (a==1) ? cells[p].get<1>() : cells[p].get<2>();
+      const size_t y = (a==0) ? cells[p-1].get<0>() : (a==1) ? cells[p-1].get<1>() : cells[p-1].get<2>();
+      d += (x > y) ? x - y : y - x;
+    }
+    ASSERT_EQ(1, d);
+  }
+}
+
+TEST(layout_test, hilbert_anisotropic)
+{
+  // Padding follows every axis, not a cube on the longest one
+  EXPECT_EQ(512u*512*8, hilbert_layout::size(cube_index{512,512,8}));
+  EXPECT_EQ(32u*4*8, hilbert_layout::size(cube_index{17,3,8}));
+
+  const cube_index n{32,4,8};
+  std::vector<cube_index> cells(hilbert_layout::size(n), cube_index{0,0,0});
+  std::vector<int> seen(cells.size());
+  for (size_t k=0; k<8; ++k) {
+    for (size_t j=0; j<4; ++j) {
+      for (size_t i=0; i<32; ++i) {
+        const auto p = hilbert_layout::index(i,j,k,n);
+        ASSERT_LT(p, seen.size());
+        ASSERT_EQ(0, seen[p]++);
+      }
+    }
+  }
+  hilbert_layout::visit([&cells](size_t p, const cube_index & i) { cells[p] = i; }, n, 0, cells.size());
+  // Tiles of 4x4x4 cells, each walked by face neighbours
+  for (size_t p=1; p<cells.size(); ++p) {
+    if (p % 64 == 0) continue;
+    int d = 0;
+    for (int a=0; a<3; ++a) {
+      const size_t x = (a==0) ? cells[p].get<0>() : (a==1) ? cells[p].get<1>() : cells[p].get<2>();
+      const size_t y = (a==0) ? cells[p-1].get<0>() : (a==1) ? cells[p-1].get<1>() : cells[p-1].get<2>();
+      d += (x > y) ? x - y : y - x;
+    }
+    ASSERT_EQ(1, d) << p;
+  }
+}
+
+TYPED_TEST(layout_test, cube_access)
+{
+  using cube = yapl::cube<int, typename TestFixture::policy_type>;
+  cube c{7,5,6};
+  c.all().apply_indexed([](int & x, const cube_index & i) {
+    x = i.get<0>() + 10 * i.get<1>() + 100 * i.get<2>();
+  });
+  for (size_t k=0; k<6; ++k) {
+    for (size_t j=0; j<5; ++j) {
+      for (size_t i=0; i<7; ++i) {
+        ASSERT_EQ(int(i + 10*j + 100*k), c(i,j,k));
+        ASSERT_EQ(int(i + 10*j + 100*k), c(cube_index{i,j,k}));
+      }
+    }
+  }
+}
+
+TYPED_TEST(layout_test, flat_sweeps_skip_padding)
+{
+  using cube = yapl::cube<int, typename TestFixture::policy_type>;
+  cube c{7,5,6};
+  c.all().apply([](int & x) { x += 1; });
+  int n = 0;
+  c.all_ordered().apply([&n](int & x) { n += x; });
+  EXPECT_EQ(7*5*6, n);
+  EXPECT_EQ(7*5*6, c.all().reduce(0, [](int x, int y) { return x+y; }));
+}
+
+TYPED_TEST(layout_test, ordered_sweeps_follow_cube_index)
+{
+  using cube = yapl::cube<int, typename TestFixture::parallel_policy_type>;
+  cube c{7,5,6};
+  c.all().apply_indexed([](int & x, const cube_index & i) {
+    x = i.get<0>() + 7 * (i.get<1>() + 5 * i.get<2>());
+  });
+
+  std::vector<int> seen;
+  c.all_ordered().apply([&seen](int & x) { seen.push_back(x); });
+  ASSERT_EQ(7u*5*6, seen.size());
+  for (size_t q=0; q<seen.size(); ++q) {
+    ASSERT_EQ(int(q), seen[q]);
+  }
+
+  seen.clear();
+  c.all_ordered().apply_indexed([](int & x, const cube_index & i) {
+      return x - int(i.get<0>() + 7 * (i.get<1>() + 5 * i.get<2>())) + x;
+    },
+    [&seen](int x) { seen.push_back(x); });
+  ASSERT_EQ(7u*5*6, seen.size());
+  for (size_t q=0; q<seen.size(); ++q) {
+    ASSERT_EQ(int(q), seen[q]);
+  }
+}
+
+TEST(layout_test, soa_ordered_sweeps_follow_cube_index)
+{
+  using particle = soa<double, int>;
+  using cube = yapl::cube<particle, policy<sequential_executor<particle>,
+      default_partitioner, 0, new_allocation, hilbert_layout>>;
+  cube c{5,3,4};
+  c.all().apply_indexed([](cube::reference x, const cube_index & i) {
+    x.get<1>() = i.get<0>() + 5 * (i.get<1>() + 3 * i.get<2>());
+  });
+  int next = 0;
+  c.all_ordered().apply([&next](cube::reference x) { EXPECT_EQ(next++, x.get<1>()); });
+  EXPECT_EQ(5*3*4, next);
+}
+
+TYPED_TEST(layout_test, parallel_apply_indexed)
+{
+  using cube = yapl::cube<int, typename TestFixture::parallel_policy_type>;
+  cube c{17,9,10};
+  c.all().apply_indexed([](int & x, const cube_index & i) {
+    x = i.get<0>() + 100 * i.get<1>() + 10000 * i.get<2>();
+  });
+  EXPECT_EQ(16 + 800 + 90000, c(16,8,9));
+  EXPECT_EQ(3 + 500 + 20000, c(3,5,2));
+  int total = c.all().transform_reduce_indexed(0, [](int x, int y) { return x+y; },
+      [](int x, const cube_index & i) { return x == int(i.get<0>() + 100 * i.get<1>() + 10000 * i.get<2>()); });
+  EXPECT_EQ(17*9*10, total);
+}
+
+TYPED_TEST(layout_test, planes)
+{
+  using cube = yapl::cube<int, typename TestFixture::policy_type>;
+  cube c{7,5,6};
+  c.template plane<0>(6).apply([](int & x) { x += 1; });
+  c.template plane<1>(2).apply([](int & x) { x += 10; });
+  c.template plane<2>(5).apply([](int & x) { x += 100; });
+  EXPECT_EQ(111, c(6,2,5));
+  EXPECT_EQ(11, c(6,2,0));
+  EXPECT_EQ(0, c(5,3,4));
+  EXPECT_EQ(5*6 + 10*7*6 + 100*7*5,
+      c.all().reduce(0, [](int x, int y) { return x+y; }));
+  auto plus = [](int x, int y) { return x+y; };
+  EXPECT_EQ(5*6 + 10*6 + 100*5, c.template plane<0>(6).reduce(0, plus));
+  EXPECT_EQ(4 * 7 * 5, c.template plane<2>(4).transform_reduce_indexed(0, plus,
+      [](int, const cube_index & i) { return int(i.get<2>()); }));
+}
+
+TYPED_TEST(layout_test, neighbours)
+{
+  using cube = yapl::cube<int, typename TestFixture::policy_type>;
+  using reference_cube = yapl::cube<int, default_policy<int>>;
+  cube c{7,5,6};
+  reference_cube r{7,5,6};
+  auto set = [](int & x, const cube_index & i) { x = i.get<0>() + 10 * i.get<1>() + 100 * i.get<2>(); };
+  c.all().apply_indexed(set);
+  r.all().apply_indexed(set);
+  for (size_t k=0; k<6; ++k) {
+    for (size_t j=0; j<5; ++j) {
+      for (size_t i=0; i<6; ++i) {
+        int sc = 0, sr = 0;
+        c.for_all_neighbours(cube_index{i,j,k}, [&sc](int x) { sc += x; });
+        r.for_all_neighbours(cube_index{i,j,k}, [&sr](int x) { sr += x; });
+        ASSERT_EQ(sr, sc);
+        sc = sr = 0;
+        c.for_all_neighbours_unique(i,j,k, [&sc](int x) { sc += x; });
+        r.for_all_neighbours_unique(i,j,k, [&sr](int x) { sr += x; });
+        ASSERT_EQ(sr, sc);
+      }
+    }
+  }
+}
+
+// Reductions over padded layouts, where chunks may start on padding or hold
+// no cell at all. A non-zero init must be folded in exactly once.
+template <typename P>
+class padded_reduction_test : public ::testing::Test {
+public:
+  using cube_type = yapl::cube<double, P>;
+};
+
+typedef ::testing::Types<
+  policy<sequential_executor<double>, default_partitioner, 0, new_allocation, morton_layout>,
+  policy<thread_executor<double>, default_partitioner, 0, new_allocation, morton_layout>,
+  policy<thread_executor<double>, default_partitioner, 0, new_allocation, hilbert_layout>
+#ifdef YAPL_HAVE_TBB
+  , policy<tbb_executor<double>, default_partitioner, 0, new_allocation, hilbert_layout>
+#endif
+#ifdef YAPL_HAVE_OPENMP
+  , policy<openmp_executor<double>, default_partitioner, 0, new_allocation, morton_layout>
+  , policy<openmp_executor<double>, default_partitioner, 0, new_allocation, hilbert_layout>
+#endif
+> padded_reduction_types;
+TYPED_TEST_CASE(padded_reduction_test, padded_reduction_types);
+
+TYPED_TEST(padded_reduction_test, init_once)
+{
+  using cube = typename TestFixture::cube_type;
+  auto plus = [](double x, double y) { return x+y; };
+  cube c{3,3,5};
+  c.all().apply([](double & x) { x = 1.0; });
+  EXPECT_EQ(145.0, c.all().reduce(100.0, plus));
+  EXPECT_EQ(145.0, c.all().transform_reduce_indexed(100.0, plus,
+      [](double x, const cube_index &) { return x; }));
+  EXPECT_EQ(145.0, c.all().reduce(100.0, plus, deterministic_reduction{}));
+}
+
+TYPED_TEST(padded_reduction_test, deterministic_chunks_on_padding)
+{
+  using cube = typename TestFixture::cube_type;
+  auto plus = [](double x, double y) { return x+y; };
+  cube c{33,17,9};
+  c.all().apply([](double & x) { x = 1.0; });
+  EXPECT_EQ(100.0 + 33*17*9, c.all().reduce(100.0, plus, deterministic_reduction{}));
+  EXPECT_EQ(100.0 + 33*17*9, c.all().reduce(100.0, plus));
+}
+
+TEST(layout_test, padded_soa_reduction)
+{
+  using particle = soa<double, int>;
+  using cube = yapl::cube<particle, policy<thread_executor<particle>,
+      default_partitioner, 0, new_allocation, morton_layout>>;
+  cube c{3,3,5};
+  c.all().apply([](cube::reference x) { x.get<1>() = 1; });
+  EXPECT_EQ(145, c.all().transform_reduce(100, [](int x, int y) { return x+y; },
+      [](cube::const_reference x) { return x.get<1>(); }));
+}
@@ -22,7 +22,10 @@ SOFTWARE.
 #include "block.h"
 #include "cube_mapping.h"
 #include "policy.h"
+#include "layout.h"
+#include "threadexecutor.h"
 #include <gtest/gtest.h>
+#include <vector>
 
 using namespace yapl;
 using namespace std;
@@ -112,3 +115,137 @@ TYPED_TEST(plane_cube_mapping_test, apply_plane2)
 
 
 
+
+TYPED_TEST(plane_cube_mapping_test, reduce_planes)
+{
+  using block_type = typename TestFixture::block_type;
+  block_type b(24);
+  full_cube_mapping<block_type> all(&b,2,3,4);
+  all.apply_indexed([](TypeParam & x, const cube_index & i) {
+    x = i.get<0>() + 10 * i.get<1>() + 100 * i.get<2>();
+  });
+  auto plus = [](TypeParam x, TypeParam y) { return x+y; };
+  plane_cube_mapping<block_type,0> px1(&b,1,2,3,4);
+  plane_cube_mapping<block_type,1> py2(&b,2,2,3,4);
+  plane_cube_mapping<block_type,2> pz3(&b,3,2,3,4);
+  // x=1 plane: 12 cells, sum 12*1 + 10*(0+1+2)*4 + 100*(0+1+2+3)*3
+  EXPECT_EQ(TypeParam{12 + 120 + 1800}, px1.reduce(TypeParam{0}, plus));
+  // y=2 plane: 8 cells, sum (0+1)*4 + 20*8 + 100*(0+1+2+3)*2
+  EXPECT_EQ(TypeParam{4 + 160 + 1200}, py2.reduce(TypeParam{0}, plus));
+  // z=3 plane: 6 cells, sum (0+1)*3 + 10*(0+1+2)*2 + 300*6
+  EXPECT_EQ(TypeParam{3 + 60 + 1800}, pz3.reduce(TypeParam{0}, plus, deterministic_reduction{}));
+}
+
+TYPED_TEST(plane_cube_mapping_test, transform_reduce_indexed_planes)
+{
+  using block_type = typename TestFixture::block_type;
+  block_type b(24);
+  plane_cube_mapping<block_type,0> px1(&b,1,2,3,4);
+  plane_cube_mapping<block_type,1> py2(&b,2,2,3,4);
+  plane_cube_mapping<block_type,2> pz3(&b,3,2,3,4);
+  auto count_if = [](int c) {
+    return [c](TypeParam &, const cube_index & i) { 
+      return (c==0 && i.get<0>()==1) || (c==1 && i.get<1>()==2) || (c==2 && i.get<2>()==3) ? 1 : 0; 
+    };
+  };
+  auto plus = [](int x, int y) { return x+y; };
+  EXPECT_EQ(12, px1.transform_reduce_indexed(0, plus, count_if(0)));
+  EXPECT_EQ(8, py2.transform_reduce_indexed(0, plus, count_if(1)));
+  EXPECT_EQ(6, pz3.transform_reduce_indexed(0, plus, count_if(2)));
+}
+
+TYPED_TEST(plane_cube_mapping_test, apply_indexed_planes)
+{
+  using block_type = typename TestFixture::block_type;
+  block_type b(24);
+  full_cube_mapping<block_type> all(&b,2,3,4);
+  all.apply([](TypeParam & x) { x = 0; });
+  plane_cube_mapping<block_type,1> py2(&b,2,2,3,4);
+  py2.apply_indexed([](TypeParam & x, const cube_index & i) {
+    EXPECT_EQ(2u, i.get<1>());
+    x = i.get<0>() + 10 * i.get<2>();
+  });
+  for (int i=0; i<24; ++i) {
+    const size_t x = i % 2;
+    const size_t y = (i / 2) % 3;
+    const size_t z = i / 6;
+    ASSERT_EQ((y==2) ? TypeParam(x + 10*z) : TypeParam{0}, b[i]);
+  }
+}
+
+TYPED_TEST(plane_cube_mapping_test, gather_xplane)
+{
+  using block_type = typename TestFixture::block_type;
+  block_type b(24);
+  full_cube_mapping<block_type> all(&b,2,3,4);
+  all.apply_indexed([](TypeParam & x, const cube_index & i) {
+    x = i.get<0>() + 10 * i.get<1>() + 100 * i.get<2>();
+  });
+  plane_cube_mapping<block_type,0> px1(&b,1,2,3,4);
+  ASSERT_EQ(12u, px1.size());
+  std::vector<TypeParam> v(px1.size());
+  px1.gather(v.data());
+  for (size_t q=0; q<12; ++q) {
+    EXPECT_EQ(TypeParam(1 + 10 * (q % 3) + 100 * (q / 3)), v[q]);
+  }
+}
+
+TYPED_TEST(plane_cube_mapping_test, scatter_planes)
+{
+  using block_type = typename TestFixture::block_type;
+  block_type b(24);
+  full_cube_mapping<block_type> all(&b,2,3,4);
+  all.apply([](TypeParam & x) { x = 0; });
+  plane_cube_mapping<block_type,0> px0(&b,0,2,3,4);
+  plane_cube_mapping<block_type,1> py1(&b,1,2,3,4);
+  plane_cube_mapping<block_type,2> pz2(&b,2,2,3,4);
+  std::vector<TypeParam> v(12, TypeParam{1});
+  px0.scatter(v.data());
+  py1.scatter(v.data());
+  pz2.scatter(v.data());
+  // 12 + 8 + 6 cells, minus cells in two planes, plus the cell in all three
+  EXPECT_EQ(TypeParam(12 + 8 + 6 - 4 - 3 - 2 + 1), all.reduce(TypeParam{0},
+      [](TypeParam x, TypeParam y) { return x+y; }));
+}
+
+template <typename P>
+class parallel_plane_cube_mapping_test : public ::testing::Test {
+public:
+  using block_type = block<int, P>;
+};
+
+typedef ::testing::Types<
+  policy<thread_executor<int>>,
+  policy<thread_executor<int>, default_partitioner, 0, new_allocation, morton_layout>
+> parallel_test_types;
+TYPED_TEST_CASE(parallel_plane_cube_mapping_test, parallel_test_types);
+
+TYPED_TEST(parallel_plane_cube_mapping_test, apply_gather_scatter)
+{
+  using block_type = typename TestFixture::block_type;
+  using layout = typename block_type::layout_type;
+  const cube_index n{7,9,11};
+  block_type b(layout::size(n));
+  full_cube_mapping<block_type> all(&b,n);
+  all.apply_indexed([](int & x, const cube_index & i) {
+    x = i.get<0>() + 10 * i.get<1>() + 100 * i.get<2>();
+  });
+  plane_cube_mapping<block_type,0> px(&b,3,n);
+  plane_cube_mapping<block_type,1> py(&b,4,n);
+  plane_cube_mapping<block_type,2> pz(&b,5,n);
+  px.apply([](int & x) { x = -x; });
+  EXPECT_EQ(-(9*11*3 + 10*36*11 + 100*55*9), px.reduce(0, [](int x, int y) { return x+y; }));
+  std::vector<int> v(py.size());
+  py.gather(v.data());
+  for (size_t q=0; q<v.size(); ++q) {
+    const int x = q % 7;
+    const int z = q / 7;
+    EXPECT_EQ((x==3 ? -1 : 1) * (x + 40 + 100*z), v[q]);
+  }
+  std::vector<int> w(pz.size(), 1);
+  pz.scatter(w.data());
+  pz.apply_indexed([](int & x, const cube_index & i) {
+    EXPECT_EQ(5u, i.get<2>());
+    EXPECT_EQ(1, x);
+  });
+}
@@ -0,0 +1,168 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#include "cube.h"
+#include "layout.h"
+#include "policy.h"
+#include "threadexecutor.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <functional>
+
+using namespace yapl;
+using namespace std;
+
+template <typename P>
+class region_cube_mapping_test : public ::testing::Test {
+public:
+  using cube_type = cube<int, P>;
+};
+
+typedef ::testing::Types<
+  policy<sequential_executor<int>>,
+  policy<thread_executor<int>>,
+  policy<thread_executor<int>, default_partitioner, 0, new_allocation, brick_layout<2,2,2>>,
+  policy<thread_executor<int>, default_partitioner, 0, new_allocation, morton_layout>
+> my_test_types;
+TYPED_TEST_CASE(region_cube_mapping_test, my_test_types);
+
+namespace {
+
+bool inside(size_t i, size_t j, size_t k, const cube_index & lo, const cube_index & hi)
+{
+  return lo.get<0>()<=i && i<hi.get<0>() &&
+         lo.get<1>()<=j && j<hi.get<1>() &&
+         lo.get<2>()<=k && k<hi.get<2>();
+}
+
+template <typename C>
+void set_positions(C & c)
+{
+  c.all().apply_indexed([](int & x, const cube_index & i) {
+    x = i.get<0>() + 10 * i.get<1>() + 100 * i.get<2>();
+  });
+}
+
+}
+
+TYPED_TEST(region_cube_mapping_test, apply)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,6,7};
+  c.all().apply([](int & x) { x = 0; });
+  const cube_index lo{1,2,3};
+  const cube_index hi{4,5,7};
+  c.region(lo,hi).apply([](int & x) { x = 1; });
+  for (size_t k=0; k<7; ++k) {
+    for (size_t j=0; j<6; ++j) {
+      for (size_t i=0; i<5; ++i) {
+        EXPECT_EQ(inside(i,j,k,lo,hi) ? 1 : 0, c(i,j,k)) << cube_index(i,j,k);
+      }
+    }
+  }
+}
+
+TYPED_TEST(region_cube_mapping_test, apply_indexed)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,6,7};
+  set_positions(c);
+  const cube_index lo{0,1,2};
+  const cube_index hi{5,3,6};
+  c.region(lo,hi).apply_indexed([](int & x, const cube_index & i) {
+    EXPECT_EQ(static_cast<int>(i.get<0>() + 10 * i.get<1>() + 100 * i.get<2>()), x);
+    x = -1;
+  });
+  for (size_t k=0; k<7; ++k) {
+    for (size_t j=0; j<6; ++j) {
+      for (size_t i=0; i<5; ++i) {
+        EXPECT_EQ(inside(i,j,k,lo,hi), c(i,j,k)==-1) << cube_index(i,j,k);
+      }
+    }
+  }
+}
+
+TYPED_TEST(region_cube_mapping_test, reduce)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,6,7};
+  set_positions(c);
+  const cube_index lo{1,0,2};
+  const cube_index hi{3,6,5};
+  int expected = 0;
+  for (size_t k=2; k<5; ++k) {
+    for (size_t j=0; j<6; ++j) {
+      for (size_t i=1; i<3; ++i) {
+        expected += c(i,j,k);
+      }
+    }
+  }
+  EXPECT_EQ(expected, c.region(lo,hi).reduce(0, std::plus<int>{}));
+  EXPECT_EQ(expected, c.region(lo,hi).reduce(0, std::plus<int>{}, deterministic_reduction{}));
+  EXPECT_EQ(2*expected, c.region(lo,hi).transform_reduce(0, std::plus<int>{},
+      [](int x) { return 2*x; }));
+}
+
+TYPED_TEST(region_cube_mapping_test, transform_reduce_indexed)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,6,7};
+  const cube_index lo{1,1,1};
+  const cube_index hi{4,5,6};
+  auto n = c.region(lo,hi).transform_reduce_indexed(0, std::plus<int>{},
+      [](int, const cube_index & i) { return static_cast<int>(i.get<1>()); });
+  EXPECT_EQ(3 * (1+2+3+4) * 5, n);
+}
+
+TYPED_TEST(region_cube_mapping_test, const_region)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,6,7};
+  c.all().apply([](int & x) { x = 1; });
+  const cube & cc = c;
+  EXPECT_EQ(2*3*4, cc.region({1,1,1},{3,4,5}).reduce(0, std::plus<int>{}));
+  std::atomic<int> n{0};
+  cc.region({0,0,0},{5,6,1}).apply_indexed([&n](int x, const cube_index & i) {
+    EXPECT_EQ(0u, i.get<2>());
+    if (x==1) ++n;
+  });
+  EXPECT_EQ(5*6, n);
+}
+
+TYPED_TEST(region_cube_mapping_test, empty)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,6,7};
+  c.all().apply([](int & x) { x = 1; });
+  c.region({2,2,2},{2,5,5}).apply([](int & x) { x = 0; });
+  c.region({2,2,2},{5,2,5}).apply([](int & x) { x = 0; });
+  EXPECT_EQ(5*6*7, c.all().reduce(0, std::plus<int>{}));
+  EXPECT_EQ(7, c.region({0,0,0},{0,0,0}).reduce(7, std::plus<int>{}));
+}
+
+TYPED_TEST(region_cube_mapping_test, whole_cube)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{5,6,7};
+  set_positions(c);
+  EXPECT_EQ(c.all().reduce(0, std::plus<int>{}),
+      c.region({0,0,0},{5,6,7}).reduce(0, std::plus<int>{}));
+}
@@ -0,0 +1,208 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#include "soa.h"
+#include "cube.h"
+#include "policy.h"
+#include "seqexecutor.h"
+#include "threadexecutor.h"
+#ifdef YAPL_HAVE_TBB
+#include "tbbexecutor.h"
+#endif
+#ifdef YAPL_HAVE_OPENMP
+#include "ompexecutor.h"
+#endif
+#include <gtest/gtest.h>
+#include <tuple>
+
+using namespace yapl;
+using namespace std;
+
+using particle = soa<double, double, int>;
+
+template <typename P>
+class soa_test : public ::testing::Test {
+public:
+  using cube_type = cube<particle, P>;
+  using reference = typename cube_type::reference;
+  using const_reference = typename cube_type::const_reference;
+};
+
+typedef ::testing::Types<
+  policy<sequential_executor<particle>>,
+  policy<thread_executor<particle>>,
+  policy<sequential_executor<particle>, default_partitioner, 0, cache_aligned_allocation>
+#ifdef YAPL_HAVE_TBB
+  , policy<tbb_executor<particle>>
+#endif
+#ifdef YAPL_HAVE_OPENMP
+  , policy<openmp_executor<particle>>
+#endif
+> my_test_types;
+TYPED_TEST_CASE(soa_test, my_test_types);
+
+TYPED_TEST(soa_test, value_initialized)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{3,4,5};
+  EXPECT_FLOAT_EQ(0.0, c(2,3,4).template get<0>());
+  EXPECT_FLOAT_EQ(0.0, c(2,3,4).template get<1>());
+  EXPECT_EQ(0, get<2>(c(2,3,4)));
+}
+
+TYPED_TEST(soa_test, proxy_assign)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{3,4,5};
+  c(1,2,3) = make_tuple(1.5, 2.5, 3);
+  c(0,0,0) = c(1,2,3);
+  EXPECT_EQ(make_tuple(1.5, 2.5, 3), (tuple<double,double,int>(c(0,0,0))));
+  c(1,2,3).template get<0>() = 4.0;
+  EXPECT_FLOAT_EQ(1.5, get<0>(c(0,0,0)));
+  EXPECT_FLOAT_EQ(4.0, get<0>(c(1,2,3)));
+}
+
+TYPED_TEST(soa_test, fields_are_contiguous)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{3,4,5};
+  EXPECT_EQ(&get<0>(c(0,0,0)) + 1, &get<0>(c(1,0,0)));
+  EXPECT_EQ(&get<2>(c(0,0,0)) + 3, &get<2>(c(0,1,0)));
+}
+
+TYPED_TEST(soa_test, apply)
+{
+  using cube = typename TestFixture::cube_type;
+  using reference = typename TestFixture::reference;
+  cube c{10,20,30};
+  c.all().apply([](reference x) {
+    get<0>(x) = 1.0;
+    get<1>(x) = 2.0;
+    get<2>(x) = 3;
+  });
+  for (size_t k=0; k<30; ++k) {
+    for (size_t j=0; j<20; ++j) {
+      for (size_t i=0; i<10; ++i) {
+        ASSERT_EQ(make_tuple(1.0, 2.0, 3), (tuple<double,double,int>(c(i,j,k))));
+      }
+    }
+  }
+}
+
+TYPED_TEST(soa_test, apply_indexed)
+{
+  using cube = typename TestFixture::cube_type;
+  using reference = typename TestFixture::reference;
+  cube c{10,20,30};
+  c.all().apply_indexed([](reference x, const cube_index & i) {
+    get<0>(x) = i.get<0>();
+    get<2>(x) = i.get<0>() + 10 * i.get<1>() + 200 * i.get<2>();
+  });
+  for (size_t k=0; k<30; ++k) {
+    for (size_t j=0; j<20; ++j) {
+      for (size_t i=0; i<10; ++i) {
+        ASSERT_FLOAT_EQ(i, get<0>(c(i,j,k)));
+        ASSERT_EQ(int(i + 10*j + 200*k), get<2>(c(i,j,k)));
+      }
+    }
+  }
+}
+
+TYPED_TEST(soa_test, ordered_apply)
+{
+  using cube = typename TestFixture::cube_type;
+  using reference = typename TestFixture::reference;
+  cube c{4,5,6};
+  int n = 0;
+  c.all_ordered().apply([&n](reference x) { get<2>(x) = n++; });
+  EXPECT_EQ(4*5*6-1, get<2>(c(3,4,5)));
+  EXPECT_EQ(4, get<2>(c(0,1,0)));
+}
+
+TYPED_TEST(soa_test, field_mapping)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{10,20,30};
+  c.template field<1>().apply([](double & x) { x = 2.0; });
+  c.template field<2>().apply_indexed([](int & x, const cube_index & i) { x = i.get<2>(); });
+  EXPECT_FLOAT_EQ(0.0, get<0>(c(9,19,29)));
+  EXPECT_FLOAT_EQ(2.0, get<1>(c(9,19,29)));
+  EXPECT_EQ(29, get<2>(c(9,19,29)));
+  const cube & cc = c;
+  EXPECT_FLOAT_EQ(2.0 * 6000, cc.template field<1>().reduce(0.0, [](double x, double y) { return x+y; }));
+}
+
+TYPED_TEST(soa_test, plane)
+{
+  using cube = typename TestFixture::cube_type;
+  using reference = typename TestFixture::reference;
+  cube c{4,5,6};
+  c.template plane<1>(2).apply([](reference x) { get<2>(x) = 1; });
+  int total = c.all().transform_reduce(0,
+      [](int x, int y) { return x+y; },
+      [](typename TestFixture::const_reference x) { return get<2>(x); });
+  EXPECT_EQ(4*6, total);
+  EXPECT_EQ(1, get<2>(c(3,2,5)));
+  EXPECT_EQ(0, get<2>(c(3,3,5)));
+}
+
+TYPED_TEST(soa_test, transform_reduce)
+{
+  using cube = typename TestFixture::cube_type;
+  using reference = typename TestFixture::reference;
+  using const_reference = typename TestFixture::const_reference;
+  cube c{10,20,30};
+  c.all().apply_indexed([](reference x, const cube_index & i) {
+    get<0>(x) = 0.5;
+    get<1>(x) = i.get<2>();
+  });
+  auto plus = [](double x, double y) { return x+y; };
+  EXPECT_FLOAT_EQ(1.0 + 0.5 * 6000,
+      c.all().transform_reduce(1.0, plus, [](const_reference x) { return get<0>(x); }));
+  EXPECT_FLOAT_EQ(200 * (29*30/2),
+      c.all().transform_reduce_indexed(0.0, plus,
+        [](const_reference x, const cube_index & i) { return get<1>(x) * (i.get<0>() < 10); },
+        deterministic_reduction{}));
+  EXPECT_FLOAT_EQ(200 * 7.0,
+      c.template plane<2>(7).transform_reduce(0.0, plus, [](const_reference x) { return get<1>(x); }));
+}
+
+TYPED_TEST(soa_test, first_touch_init)
+{
+  using cube = typename TestFixture::cube_type;
+  cube c{3,4,5, first_touch_init};
+  EXPECT_FLOAT_EQ(0.0, get<1>(c(2,3,4)));
+}
+
+TYPED_TEST(soa_test, region)
+{
+  using cube = typename TestFixture::cube_type;
+  using reference = typename TestFixture::reference;
+  using const_reference = typename TestFixture::const_reference;
+  cube c{4,5,6};
+  c.region({1,1,1},{3,4,5}).apply([](reference x) { get<2>(x) = 1; });
+  const cube & cc = c;
+  EXPECT_EQ(2*3*4, cc.region({0,0,0},{4,5,6}).transform_reduce(0,
+      [](int x, int y) { return x+y; },
+      [](const_reference x) { return get<2>(x); }));
+  EXPECT_EQ(1, get<2>(c(2,3,4)));
+  EXPECT_EQ(0, get<2>(c(3,3,4)));
+}
@@ -0,0 +1,199 @@
+/*
+Copyright (c) 2013 J. Daniel Garcia <josedaniel.garcia@uc3m.es>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+SOFTWARE.
+ */
+#include "stencil.h"
+#include "boundary.h"
+#include "cube.h"
+#include "layout.h"
+#include "policy.h"
+#include "threadexecutor.h"
+#ifdef YAPL_HAVE_TBB
+#include "tbbexecutor.h"
+#endif
+#include <gtest/gtest.h>
+
+using namespace yapl;
+using namespace std;
+
+template <typename P>
+class stencil_test : public ::testing::Test {
+public:
+  using cube_type = cube<int, P>;
+};
+
+typedef ::testing::Types<
+  policy<sequential_executor<int>>,
+  policy<thread_executor<int>>,
+  policy<thread_executor<int>, default_partitioner, 0, new_allocation, brick_layout<2,2,2>>
+#ifdef YAPL_HAVE_TBB
+  , policy<tbb_executor<int>, tbb::affinity_partitioner>
+#endif
+> my_test_types;
+TYPED_TEST_CASE(stencil_test, my_test_types);
+
+namespace {
+
+int value_of(std::ptrdiff_t i, std::ptrdiff_t j, std::ptrdiff_t k)
+{
+  return (i * 7 + j * 13 + k * 29) % 17;
+}
+
+template <typename C>
+void set_values(C & c)
+{
+  c.all().apply_indexed([](int & x, const cube_index & i) {
+    x = value_of(i.get<0>(), i.get<1>(), i.get<2>());
+  });
+}
+
+// Laplacian with zero cells outside an nx x ny x nz cube
+int laplacian_of(std::ptrdiff_t i, std::ptrdiff_t j, std::ptrdiff_t k,
+    std::ptrdiff_t nx, std::ptrdiff_t ny, std::ptrdiff_t nz)
+{
+  auto v = [=](std::ptrdiff_t x, std::ptrdiff_t y, std::ptrdiff_t z) {
+    return (x<0 || x>=nx || y<0 || y>=ny || z<0 || z>=nz) ? 0 : value_of(x,y,z);
+  };
+  return v(i-1,j,k) + v(i+1,j,k) + v(i,j-1,k) + v(i,j+1,k) + v(i,j,k-1) + v(i,j,k+1) - 6 * v(i,j,k);
+}
+
+}
+
+TEST(stencil_shape, reach_and_size)
+{
+  EXPECT_EQ(7u, laplacian_7::size);
+  EXPECT_EQ(1, laplacian_7::reach);
+  EXPECT_EQ(27u, average_27::size);
+  EXPECT_EQ(2, (stencil<1, stencil_point<0,0,0>, stencil_point<0,-2,1>>::reach));
+}
+
+TEST(stencil_shape, evaluate)
+{
+  // 3x3x3 block of values, centre at linear position 13
+  int v[27];
+  for (int i=0; i<27; ++i) v[i] = i;
+  EXPECT_EQ(0, laplacian_7::evaluate(v + 13, 3, 9));
+  EXPECT_EQ(13, average_27::evaluate(v + 13, 3, 9));
+  EXPECT_EQ(13 + 12 - 10, (stencil<1, stencil_point<0,0,0>, stencil_point<-1,0,0>, stencil_point<0,-1,0,-1>>::evaluate(v + 13, 3, 9)));
+}
+
+TYPED_TEST(stencil_test, laplacian_zero_boundary)
+{
+  using cube = typename TestFixture::cube_type;
+  cube in{9,7,6};
+  cube out{9,7,6};
+  set_values(in);
+  apply_stencil<laplacian_7>(in, out, zero_boundary{});
+  for (size_t k=0; k<6; ++k) {
+    for (size_t j=0; j<7; ++j) {
+      for (size_t i=0; i<9; ++i) {
+        ASSERT_EQ(laplacian_of(i,j,k,9,7,6), out(i,j,k)) << cube_index(i,j,k);
+      }
+    }
+  }
+}
+
+TYPED_TEST(stencil_test, clamp_boundary_constant)
+{
+  using cube = typename TestFixture::cube_type;
+  cube in{5,6,7};
+  cube out{5,6,7};
+  in.all().apply([](int & x) { x = 3; });
+  apply_stencil<average_27>(in, out, clamp_boundary{});
+  EXPECT_EQ(3*5*6*7, out.all().reduce(0, [](int x, int y) { return x+y; }));
+  apply_stencil<laplacian_7>(in, out, clamp_boundary{});
+  EXPECT_EQ(0, out.all().reduce(0, [](int x, int y) { return x+y; }));
+}
+
+TYPED_TEST(stencil_test, copy_boundary)
+{
+  using cube = typename TestFixture::cube_type;
+  cube in{4,4,4};
+  cube out{4,4,4};
+  in.all().apply([](int & x) { x = 0; });
+  apply_stencil<laplacian_7>(in, out, make_copy_boundary(1));
+  EXPECT_EQ(3, out(0,0,0));
+  EXPECT_EQ(2, out(0,0,1));
+  EXPECT_EQ(1, out(0,1,1));
+  EXPECT_EQ(0, out(1,1,1));
+}
+
+TYPED_TEST(stencil_test, periodic_boundary)
+{
+  using cube = typename TestFixture::cube_type;
+  cube in{5,4,3};
+  cube out{5,4,3};
+  set_values(in);
+  apply_stencil<laplacian_7>(in, out, periodic_boundary{});
+  auto v = [](std::ptrdiff_t x, std::ptrdiff_t y, std::ptrdiff_t z) {
+    return value_of((x+5)%5, (y+4)%4, (z+3)%3);
+  };
+  for (std::ptrdiff_t k=0; k<3; ++k) {
+    for (std::ptrdiff_t j=0; j<4; ++j) {
+      for (std::ptrdiff_t i=0; i<5; ++i) {
+        const int expected = v(i-1,j,k) + v(i+1,j,k) + v(i,j-1,k) + v(i,j+1,k)
+            + v(i,j,k-1) + v(i,j,k+1) - 6 * v(i,j,k);
+        ASSERT_EQ(expected, out(i,j,k)) << cube_index(i,j,k);
+      }
+    }
+  }
+  // Total of a periodic Laplacian vanishes
+  EXPECT_EQ(0, out.all().reduce(0, [](int x, int y) { return x+y; }));
+}
+
+TYPED_TEST(stencil_test, thin_cube)
+{
+  using cube = typename TestFixture::cube_type;
+  cube in{2,1,3};
+  cube out{2,1,3};
+  set_values(in);
+  apply_stencil<laplacian_7>(in, out, zero_boundary{});
+  for (size_t k=0; k<3; ++k) {
+    for (size_t i=0; i<2; ++i) {
+      EXPECT_EQ(laplacian_of(i,0,k,2,1,3), out(i,0,k));
+    }
+  }
+}
+
+TYPED_TEST(stencil_test, repeated_steps)
+{
+  // Every step reuses the partitioner of the cube it writes
+  using cube = typename TestFixture::cube_type;
+  using reference_cube = yapl::cube<int, default_policy<int>>;
+  cube a{9,7,6};
+  cube b{9,7,6};
+  reference_cube ra{9,7,6};
+  reference_cube rb{9,7,6};
+  set_values(a);
+  set_values(ra);
+  for (int step=0; step<4; ++step) {
+    apply_stencil<average_7>(a, b, make_copy_boundary(1));
+    apply_stencil<average_7>(b, a, make_copy_boundary(1));
+    apply_stencil<average_7>(ra, rb, make_copy_boundary(1));
+    apply_stencil<average_7>(rb, ra, make_copy_boundary(1));
+  }
+  for (size_t k=0; k<6; ++k) {
+    for (size_t j=0; j<7; ++j) {
+      for (size_t i=0; i<9; ++i) {
+        ASSERT_EQ(ra(i,j,k), a(i,j,k)) << cube_index(i,j,k);
+      }
+    }
+  }
+}